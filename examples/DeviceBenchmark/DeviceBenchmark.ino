@@ -0,0 +1,122 @@
+/*
+   DeviceBenchmark.ino - Measure the cost of DeviceProtocol::update()
+   Created for RCProtocol.
+
+   This is the receiver half of RemoteBenchmark.  It echoes channel 0
+   back through the ack payload so the remote can measure latency, and
+   prints a report every REPORT_INTERVAL milliseconds:
+
+     - frames/s:  channel packets received per second
+     - update us: average and maximum time spent in update() when a
+                  packet was processed, and when nothing was available
+*/
+
+#include <SPI.h>
+#include <RF24.h>
+
+#include <rcDeviceProtocol.h>
+
+#define CE_PIN 9
+#define CSN_PIN 10
+
+#define REPORT_INTERVAL 2000
+
+//Link settings to benchmark, these are sent to the remote while pairing
+#define COMMS_FREQUENCY 100
+#define RETRY_DELAY 1
+#define NUM_CHANNELS 6
+
+RF24 radio(CE_PIN, CSN_PIN);
+
+const uint8_t deviceId[] = "BnDev";
+
+DeviceProtocol device(&radio, deviceId);
+RCSettings settings;
+
+uint8_t remoteId[5];
+bool connected = false;
+
+void saveRemoteID(const uint8_t* id) {
+  memcpy(remoteId, id, 5);
+}
+
+void loadRemoteID(uint8_t* id) {
+  memcpy(id, remoteId, 5);
+}
+
+bool checkConnected() {
+  return connected;
+}
+
+void setConnected(bool c) {
+  connected = c;
+}
+
+uint16_t channels[32];
+uint8_t telemetry[32];
+
+uint32_t reportTimer;
+uint32_t frames;
+uint32_t frameTime;
+uint32_t frameMax;
+uint32_t idleCalls;
+uint32_t idleTime;
+
+void resetReport() {
+  frames = 0;
+  frameTime = 0;
+  frameMax = 0;
+  idleCalls = 0;
+  idleTime = 0;
+  reportTimer = millis();
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  settings.setCommsFrequency(COMMS_FREQUENCY);
+  settings.setRetryDelay(RETRY_DELAY);
+  settings.setNumChannels(NUM_CHANNELS);
+
+  device.begin(&settings, checkConnected, loadRemoteID);
+
+  Serial.println("Pairing...");
+  while(device.pair(saveRemoteID) != 0);
+
+  Serial.println("Connecting...");
+  while(device.connect(loadRemoteID, setConnected) != 0);
+
+  resetReport();
+}
+
+void loop() {
+  uint32_t t = micros();
+  int8_t status = device.update(channels, telemetry, setConnected);
+  t = micros() - t;
+
+  if(status == 1) {
+    frames++;
+    frameTime += t;
+    frameMax = max(frameMax, t);
+
+    //echo channel 0 so the remote can measure the latency
+    telemetry[0] = channels[0] >> 8;
+    telemetry[1] = channels[0] & 0xFF;
+  } else {
+    idleCalls++;
+    idleTime += t;
+  }
+
+  if(millis() - reportTimer >= REPORT_INTERVAL) {
+    Serial.print("frames/s: ");
+    Serial.print(frames * 1000.0 / (millis() - reportTimer));
+    Serial.print(" update us: ");
+    Serial.print(frames ? frameTime / frames : 0);
+    Serial.print(" (max ");
+    Serial.print(frameMax);
+    Serial.print(") idle us: ");
+    Serial.println(idleCalls ? idleTime / idleCalls : 0);
+
+    resetReport();
+  }
+}
@@ -0,0 +1,161 @@
+/*
+   RemoteBenchmark.ino - Measure the cost of RemoteProtocol::update()
+   Created for RCProtocol.
+
+   Flash DeviceBenchmark onto the receiver, then this sketch onto the
+   remote.  Both will pair, connect, and then the remote will print a
+   report every REPORT_INTERVAL milliseconds:
+
+     - frames/s:  channel packets sent per second
+     - errors:    update() calls that returned an error
+     - update us: average and maximum time spent in update()
+     - latency:   stick-to-channel latency, measured by sending a counter
+                  in channel 0 which the device echoes back through the
+                  ack payload (round trip, so an upper bound)
+
+   The comms frequency and retry delay are set on the device, so change
+   COMMS_FREQUENCY and RETRY_DELAY in DeviceBenchmark to try other combos.
+*/
+
+#include <SPI.h>
+#include <RF24.h>
+
+#include <rcRemoteProtocol.h>
+
+#define CE_PIN 9
+#define CSN_PIN 10
+
+#define REPORT_INTERVAL 2000
+
+RF24 radio(CE_PIN, CSN_PIN);
+
+const uint8_t remoteId[] = "BnRmt";
+
+RemoteProtocol remote(&radio, remoteId);
+
+//Everything is kept in ram, there is no need to remember the pairing
+uint8_t pairedId[5];
+uint8_t pairedSettings[32];
+bool paired = false;
+
+uint8_t lastId[5] = {255, 255, 255, 255, 255};
+
+void saveSettings(const uint8_t* id, const uint8_t* settings) {
+  memcpy(pairedId, id, 5);
+  memcpy(pairedSettings, settings, 32);
+  paired = true;
+}
+
+bool checkIfValid(const uint8_t* id, uint8_t* settings) {
+  if(paired && memcmp(id, pairedId, 5) == 0) {
+    memcpy(settings, pairedSettings, 32);
+    return true;
+  }
+  return false;
+}
+
+void getLastConnection(uint8_t* id) {
+  memcpy(id, lastId, 5);
+}
+
+void setLastConnection(const uint8_t* id) {
+  memcpy(lastId, id, 5);
+}
+
+uint16_t channels[32];
+uint8_t telemetry[32];
+
+//Send times of the last 16 counter values, used to find the latency
+uint32_t sendTimes[16];
+uint16_t counter = 0;
+
+uint32_t reportTimer;
+uint32_t frames;
+uint32_t errors;
+uint32_t updateTime;
+uint32_t updateMax;
+uint32_t latencyTime;
+uint32_t latencyCount;
+uint32_t latencyMax;
+
+void resetReport() {
+  frames = 0;
+  errors = 0;
+  updateTime = 0;
+  updateMax = 0;
+  latencyTime = 0;
+  latencyCount = 0;
+  latencyMax = 0;
+  reportTimer = millis();
+}
+
+void setup() {
+  Serial.begin(115200);
+
+  remote.begin(getLastConnection, checkIfValid);
+
+  Serial.println("Pairing...");
+  while(remote.pair(saveSettings) != 0);
+
+  Serial.println("Connecting...");
+  while(remote.connect(checkIfValid, setLastConnection) != 0);
+
+  remote.getSettings()->printSettings();
+
+  for(uint8_t i = 0; i < 32; i++) {
+    channels[i] = 1500;
+  }
+
+  resetReport();
+}
+
+void loop() {
+  counter++;
+  channels[0] = counter;
+  sendTimes[counter & 15] = micros();
+
+  uint32_t t = micros();
+  int8_t status = remote.update(channels, telemetry);
+  t = micros() - t;
+
+  updateTime += t;
+  updateMax = max(updateMax, t);
+
+  if(status < 0) {
+    errors++;
+  } else {
+    frames++;
+  }
+
+  if(status == 1) {
+    //The device echoes the last counter it has received
+    uint16_t echo = (telemetry[0] << 8) | telemetry[1];
+    //Only count echoes that are still in the send history
+    if((uint16_t)(counter - echo) < 16) {
+      uint32_t latency = micros() - sendTimes[echo & 15];
+      latencyTime += latency;
+      latencyCount++;
+      latencyMax = max(latencyMax, latency);
+    }
+  }
+
+  if(millis() - reportTimer >= REPORT_INTERVAL) {
+    uint32_t calls = frames + errors;
+
+    Serial.print("frames/s: ");
+    Serial.print(frames * 1000.0 / (millis() - reportTimer));
+    Serial.print(" errors: ");
+    Serial.print(errors);
+    Serial.print(" update us: ");
+    Serial.print(calls ? updateTime / calls : 0);
+    Serial.print(" (max ");
+    Serial.print(updateMax);
+    Serial.print(") latency us: ");
+    Serial.print(latencyCount ? latencyTime / latencyCount : 0);
+    Serial.print(" (max ");
+    Serial.print(latencyMax);
+    Serial.println(")");
+
+    resetReport();
+  }
+}
@@ -0,0 +1,331 @@
+/*
+   benchmark.cpp - Measure RemoteProtocol::update() and
+   DeviceProtocol::update() over a simulated link.
+
+   A remote and a device are paired and connected through the simulated
+   RF24 (see sim/RF24.h), the device running in its own thread.  The remote
+   then sends frames for a while and a report is printed:
+
+     - frames/s:  frames sent by the remote, and received by the device,
+                  per second
+     - errors:    remote update() calls that returned an error
+     - update us: CPU time of each update() call, average and maximum.
+                  The simulated air time isn't counted.  For the device,
+                  calls that read a frame are kept apart from idle calls.
+     - latency:   stick-to-channel latency, from just before the remote's
+                  update() until the device's update() returns the channel
+
+   Usage: rc_benchmark [options]
+     -f hz      comms frequency (default 100)
+     -r delay   retry delay, in steps of 250us (default 1)
+     -c count   number of channels (default 6)
+     -b bits    channel resolution (default 16)
+     -d         dynamic payloads
+     -n         no acks
+     -l loss    chance a packet is lost, 0 to 1 (default 0)
+     -a loss    chance an ack is lost, 0 to 1 (default 0)
+     -L us      latency of the air (default 0)
+     -e chance  chance an ack goes back without its payload, 0 to 1
+                (default 0)
+     -t ms      time to send frames for (default 2000)
+     -s         sweep comms frequencies and retry delays, with the other
+                options kept
+*/
+
+#include <getopt.h>
+#include <time.h>
+
+#include <atomic>
+#include <thread>
+
+#include <RF24.h>
+
+#include <rcRemoteProtocol.h>
+#include <rcDeviceProtocol.h>
+
+//Send times of the last 256 counter values, used to find the latency
+#define LATENCY_HISTORY 256
+
+struct Options {
+  uint16_t frequency;
+  uint8_t retryDelay;
+  uint8_t numChannels;
+  uint8_t resolution;
+  bool dynamicPayload;
+  bool ack;
+  uint32_t duration;
+};
+
+struct Report {
+  uint32_t frames;
+  uint32_t errors;
+  uint32_t received;
+  uint32_t elapsed;
+  uint32_t remoteTime;
+  uint32_t remoteMax;
+  uint32_t frameCalls;
+  uint32_t frameTime;
+  uint32_t frameMax;
+  uint32_t idleCalls;
+  uint32_t idleTime;
+  uint32_t latencyTime;
+  uint32_t latencyCount;
+  uint32_t latencyMax;
+};
+
+const uint8_t remoteId[] = "BnRmt";
+const uint8_t deviceId[] = "BnDev";
+
+//Everything is kept in memory, there is no need to remember the pairing
+uint8_t pairedId[5];
+uint8_t pairedSettings[32];
+bool paired = false;
+uint8_t lastId[5];
+uint8_t deviceRemoteId[5];
+std::atomic<bool> deviceConnected;
+
+std::atomic<uint32_t> sendTimes[LATENCY_HISTORY];
+
+void saveSettings(const uint8_t* id, const uint8_t* settings) {
+  memcpy(pairedId, id, 5);
+  memcpy(pairedSettings, settings, 32);
+  paired = true;
+}
+
+bool checkIfValid(const uint8_t* id, uint8_t* settings) {
+  if(paired && memcmp(id, pairedId, 5) == 0) {
+    memcpy(settings, pairedSettings, 32);
+    return true;
+  }
+  return false;
+}
+
+void getLastConnection(uint8_t* id) {
+  memcpy(id, lastId, 5);
+}
+
+void setLastConnection(const uint8_t* id) {
+  memcpy(lastId, id, 5);
+}
+
+void saveRemoteID(const uint8_t* id) {
+  memcpy(deviceRemoteId, id, 5);
+}
+
+void loadRemoteID(uint8_t* id) {
+  memcpy(id, deviceRemoteId, 5);
+}
+
+bool checkConnected() {
+  return deviceConnected;
+}
+
+void setConnected(bool connected) {
+  deviceConnected = connected;
+}
+
+/**
+ * CPU time used by the calling thread (micros)
+ */
+uint32_t cpu_micros() {
+  timespec time;
+  clock_gettime(CLOCK_THREAD_CPUTIME_ID, &time);
+  return time.tv_sec * 1000000 + time.tv_nsec / 1000;
+}
+
+/**
+ * Pair and connect a new remote and device, and send frames for the
+ * duration
+ *
+ * @param options link to benchmark
+ * @param report report to fill
+ *
+ * @return false if the link couldn't be made
+ */
+bool run(const Options& options, Report* report) {
+  RF24 remoteRadio;
+  RF24 deviceRadio;
+  RemoteProtocol remote(&remoteRadio, remoteId);
+  DeviceProtocol device(&deviceRadio, deviceId);
+  RCSettings settings;
+
+  settings.setCommsFrequency(options.frequency);
+  settings.setRetryDelay(options.retryDelay);
+  settings.setNumChannels(options.numChannels);
+  settings.setChannelResolution(options.resolution);
+  settings.setEnableDynamicPayload(options.dynamicPayload);
+  settings.setEnableAck(options.ack);
+
+  memset(report, 0, sizeof(Report));
+  paired = false;
+  memset(lastId, 255, 5);
+  deviceConnected = false;
+
+  std::atomic<bool> stop(false);
+  std::atomic<int8_t> deviceStatus(0);
+
+  std::thread deviceThread([&]() {
+    device.begin(&settings, checkConnected, loadRemoteID);
+    if(device.pair(saveRemoteID) != 0 ||
+       device.connect(loadRemoteID, setConnected) != 0) {
+      deviceStatus = -1;
+      return;
+    }
+    deviceStatus = 1;
+
+    uint16_t channels[32] = {0};
+    uint8_t telemetry[32] = {0};
+
+    while(!stop) {
+      uint32_t t = cpu_micros();
+      int8_t status = device.update(channels, telemetry, setConnected);
+      t = cpu_micros() - t;
+
+      if(status == 1) {
+        uint32_t latency = micros() -
+                           sendTimes[channels[0] % LATENCY_HISTORY];
+        report->received++;
+        report->frameCalls++;
+        report->frameTime += t;
+        report->frameMax = max(report->frameMax, t);
+        report->latencyTime += latency;
+        report->latencyCount++;
+        report->latencyMax = max(report->latencyMax, latency);
+      } else {
+        report->idleCalls++;
+        report->idleTime += t;
+      }
+    }
+  });
+
+  //Give the device time to start listening for a pair
+  delay(20);
+  remote.begin(getLastConnection, checkIfValid);
+
+  bool linked = remote.pair(saveSettings) == 0 &&
+                remote.connect(checkIfValid, setLastConnection) == 0;
+
+  //The device finishes connecting once it hears the remote
+  while(linked && deviceStatus == 0) {
+    delay(1);
+  }
+  linked = linked && deviceStatus == 1;
+
+  uint16_t channels[32];
+  uint8_t telemetry[32];
+  uint16_t counter = 0;
+  for(uint8_t i = 0; i < 32; i++) {
+    channels[i] = 1500;
+  }
+
+  uint32_t start = millis();
+  while(linked && millis() - start < options.duration) {
+    //Only time update() itself, not the wait for its slot
+    while(!remote.poll());
+
+    //The counter has to fit in the channel resolution
+    counter = (counter + 1) & ((1UL << options.resolution) - 1);
+    channels[0] = counter;
+    sendTimes[counter % LATENCY_HISTORY] = micros();
+
+    uint32_t t = cpu_micros();
+    int8_t status = remote.update(channels, telemetry);
+    t = cpu_micros() - t;
+
+    report->remoteTime += t;
+    report->remoteMax = max(report->remoteMax, t);
+    if(status < 0 && status != RC_INFO_TICK_TOO_SHORT) {
+      report->errors++;
+    } else {
+      report->frames++;
+    }
+  }
+  report->elapsed = millis() - start;
+
+  //Let the last frame arrive
+  delay(5);
+  stop = true;
+  deviceThread.join();
+
+  return linked;
+}
+
+void print_report(const Options& options, const Report& report) {
+  uint32_t calls = report.frames + report.errors;
+  float seconds = report.elapsed / 1000.0;
+
+  printf("%4u Hz  delay %2u  frames/s %7.1f sent %7.1f received  "
+         "errors %4u  update us %4u (max %5u) remote, "
+         "%4u (max %5u) device frame, %3u device idle  "
+         "latency us %5u (max %6u)\n",
+         options.frequency, options.retryDelay,
+         report.frames / seconds, report.received / seconds,
+         report.errors,
+         calls ? report.remoteTime / calls : 0, report.remoteMax,
+         report.frameCalls ? report.frameTime / report.frameCalls : 0,
+         report.frameMax,
+         report.idleCalls ? report.idleTime / report.idleCalls : 0,
+         report.latencyCount ? report.latencyTime / report.latencyCount : 0,
+         report.latencyMax);
+}
+
+void benchmark(const Options& options) {
+  Report report;
+  if(run(options, &report)) {
+    print_report(options, report);
+  } else {
+    printf("%4u Hz  delay %2u  couldn't connect\n",
+           options.frequency, options.retryDelay);
+  }
+}
+
+int main(int argc, char** argv) {
+  Options options;
+  options.frequency = 100;
+  options.retryDelay = 1;
+  options.numChannels = 6;
+  options.resolution = 16;
+  options.dynamicPayload = false;
+  options.ack = true;
+  options.duration = 2000;
+  bool sweep = false;
+
+  int opt;
+  while((opt = getopt(argc, argv, "f:r:c:b:dnl:a:L:e:t:s")) != -1) {
+    switch(opt) {
+    case 'f': options.frequency = atoi(optarg); break;
+    case 'r': options.retryDelay = atoi(optarg); break;
+    case 'c': options.numChannels = atoi(optarg); break;
+    case 'b': options.resolution = constrain(atoi(optarg), 1, 16); break;
+    case 'd': options.dynamicPayload = true; break;
+    case 'n': options.ack = false; break;
+    case 'l': SimAir::loss = atof(optarg); break;
+    case 'a': SimAir::ackLoss = atof(optarg); break;
+    case 'L': SimAir::latency = atoi(optarg); break;
+    case 'e': SimAir::emptyAck = atof(optarg); break;
+    case 't': options.duration = atoi(optarg); break;
+    case 's': sweep = true; break;
+    default:
+      fprintf(stderr, "see the top of benchmark.cpp for the options\n");
+      return 1;
+    }
+  }
+
+  if(!sweep) {
+    benchmark(options);
+    return 0;
+  }
+
+  const uint16_t frequencies[] = {50, 100, 200, 400};
+  const uint8_t retryDelays[] = {0, 1, 5, 15};
+
+  for(uint8_t f = 0; f < sizeof(frequencies) / sizeof(frequencies[0]); f++) {
+    for(uint8_t r = 0; r < sizeof(retryDelays); r++) {
+      options.frequency = frequencies[f];
+      options.retryDelay = retryDelays[r];
+      benchmark(options);
+    }
+  }
+
+  return 0;
+}
@@ -0,0 +1,60 @@
+/*
+   Arduino.h - The parts of the Arduino core RCProtocol uses, for host builds.
+*/
+
+#ifndef __ARDUINO_H__
+#define __ARDUINO_H__
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+
+#ifndef min
+#define min(a, b) ((a) < (b) ? (a) : (b))
+#endif
+#ifndef max
+#define max(a, b) ((a) > (b) ? (a) : (b))
+#endif
+#define constrain(amt, low, high) \
+  ((amt) < (low) ? (low) : ((amt) > (high) ? (high) : (amt)))
+
+/**
+ * Micros since the program started
+ *
+ * Each call also yields, so threads that busy wait on the clock, as the
+ * protocol does, leave time for the other end of the link.
+ */
+uint32_t micros();
+uint32_t millis();
+void delay(uint32_t ms);
+void delayMicroseconds(uint32_t us);
+
+//There are no interrupts on the host, handleInterrupt() is called from a
+//thread instead.
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+/**
+ * Serial that prints to stdout
+ */
+class HostSerial {
+public:
+  void begin(unsigned long) {}
+
+  void print(const char* text) { fputs(text, stdout); }
+  void print(char c) { putchar(c); }
+  void print(double value) { printf("%.2f", value); }
+  template<typename T> void print(T value) { printf("%lld", (long long)value); }
+
+  void println() { putchar('\n'); }
+  template<typename T> void println(T value) {
+    print(value);
+    println();
+  }
+};
+
+extern HostSerial Serial;
+
+#endif
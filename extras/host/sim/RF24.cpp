@@ -0,0 +1,456 @@
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "RF24.h"
+
+HostSerial Serial;
+
+double SimAir::loss = 0;
+double SimAir::ackLoss = 0;
+uint32_t SimAir::latency = 0;
+double SimAir::emptyAck = 0;
+
+//Every radio is in the same air, so one lock covers them all
+static std::recursive_mutex air;
+static std::vector<RF24*> radios;
+static std::mt19937 chance(1);
+
+static const std::chrono::steady_clock::time_point start =
+    std::chrono::steady_clock::now();
+
+uint32_t micros() {
+  std::this_thread::yield();
+  return std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::steady_clock::now() - start).count();
+}
+
+uint32_t millis() {
+  return micros() / 1000;
+}
+
+void delay(uint32_t ms) {
+  std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(uint32_t us) {
+  std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+static bool happens(double probability) {
+  return std::uniform_real_distribution<double>(0, 1)(chance) < probability;
+}
+
+void SimAir::seed(uint32_t seed) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  chance.seed(seed);
+}
+
+RF24::RF24(uint16_t, uint16_t) {
+  _rxSize = 0;
+  _ackSize = 0;
+  _listening = false;
+  _channel = 76;
+  _dataRate = RF24_1MBPS;
+  _paLevel = RF24_PA_MAX;
+  _autoAck = true;
+  _dynamicPayloads = false;
+  _ackPayloads = false;
+  _payloadSize = 32;
+  _retryDelay = 5;
+  _retryCount = 15;
+  _arc = 0;
+  _pid = 0;
+  _fastOk = true;
+  _txOk = false;
+  _txFail = false;
+
+  memset(_pipes, 0, sizeof(_pipes));
+  memset(_txAddress, 0, sizeof(_txAddress));
+  for(uint8_t i = 0; i < 6; i++) {
+    _pipeOpen[i] = false;
+  }
+  for(uint8_t i = 0; i < 8; i++) {
+    _lastPid[i] = 0;
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _index = radios.size();
+  radios.push_back(this);
+}
+
+RF24::~RF24() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  for(size_t i = 0; i < radios.size(); i++) {
+    if(radios[i] == this) {
+      radios[i] = NULL;
+    }
+  }
+}
+
+bool RF24::begin() {
+  return true;
+}
+
+bool RF24::isPVariant() {
+  return true;
+}
+
+void RF24::powerUp() {
+}
+
+void RF24::powerDown() {
+}
+
+void RF24::startListening() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _listening = true;
+}
+
+void RF24::stopListening() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _listening = false;
+
+  //As the real radio, the TX FIFO is flushed of ack payloads
+  if(_ackPayloads) {
+    _ackSize = 0;
+  }
+}
+
+bool RF24::available() {
+  return available(NULL);
+}
+
+bool RF24::available(uint8_t* pipe) {
+  uint32_t now = micros();
+  std::lock_guard<std::recursive_mutex> lock(air);
+
+  if(_rxSize == 0 || (int32_t)(now - _rx[0].arrival) < 0) {
+    return false;
+  }
+  if(pipe) {
+    *pipe = _rx[0].pipe;
+  }
+  return true;
+}
+
+void RF24::read(void* buf, uint8_t len) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+
+  if(_rxSize == 0) {
+    memset(buf, 0, len);
+    return;
+  }
+
+  memcpy(buf, _rx[0].data, min(len, 32));
+  _rxSize--;
+  memmove(_rx, _rx + 1, _rxSize * sizeof(Packet));
+}
+
+uint8_t RF24::getDynamicPayloadSize() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  return _rxSize > 0 ? _rx[0].size : 0;
+}
+
+bool RF24::rxFifoFull() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  return _rxSize >= _FIFO_SIZE;
+}
+
+uint32_t RF24::air_time(uint8_t size) {
+  uint32_t bitsPerMilli = _dataRate == RF24_2MBPS ? 2000 :
+                          (_dataRate == RF24_250KBPS ? 250 : 1000);
+  //preamble, address, control and crc, then 130us to settle
+  return (size + 9) * 8 * 1000 / bitsPerMilli + 130;
+}
+
+RF24* RF24::find_receiver(uint8_t* pipe) {
+  for(size_t i = 0; i < radios.size(); i++) {
+    RF24* radio = radios[i];
+    if(radio == NULL || radio == this || !radio->_listening ||
+       radio->_channel != _channel || radio->_dataRate != _dataRate) {
+      continue;
+    }
+
+    for(uint8_t p = 0; p < 6; p++) {
+      if(!radio->_pipeOpen[p]) {
+        continue;
+      }
+
+      //Pipes 2 to 5 only have their own first byte
+      bool match;
+      if(p < 2) {
+        match = memcmp(radio->_pipes[p], _txAddress, 5) == 0;
+      } else {
+        match = radio->_pipes[p][0] == _txAddress[0] &&
+                memcmp(radio->_pipes[1] + 1, _txAddress + 1, 4) == 0;
+      }
+
+      if(match) {
+        *pipe = p;
+        return radio;
+      }
+    }
+  }
+  return NULL;
+}
+
+bool RF24::receive(uint8_t pipe, const void* data, uint8_t size,
+                   uint32_t arrival) {
+  if(_rxSize >= _FIFO_SIZE) {
+    return false;
+  }
+
+  Packet* packet = &_rx[_rxSize++];
+  packet->pipe = pipe;
+  packet->size = size;
+  packet->arrival = arrival;
+  memset(packet->data, 0, sizeof(packet->data));
+  memcpy(packet->data, data, size);
+  return true;
+}
+
+bool RF24::take_ack(uint8_t pipe, Packet* packet) {
+  for(uint8_t i = 0; i < _ackSize; i++) {
+    if(_ack[i].pipe == pipe) {
+      *packet = _ack[i];
+      _ackSize--;
+      memmove(_ack + i, _ack + i + 1, (_ackSize - i) * sizeof(Packet));
+      return true;
+    }
+  }
+  return false;
+}
+
+bool RF24::write(const void* buf, uint8_t len) {
+  return write(buf, len, false);
+}
+
+bool RF24::write(const void* buf, uint8_t len, const bool multicast) {
+  bool ack = _autoAck && !multicast;
+  uint8_t tries = ack ? _retryCount + 1 : 1;
+  uint8_t size = _dynamicPayloads ? min(len, 32) : _payloadSize;
+
+  //Only len bytes are read, static payloads are padded with 0
+  uint8_t data[32] = {0};
+  memcpy(data, buf, min(len, size));
+  _pid++;
+
+  for(_arc = 0; _arc < tries; _arc++) {
+    delayMicroseconds(air_time(size));
+
+    {
+      std::lock_guard<std::recursive_mutex> lock(air);
+      if(_listening) {
+        return false;
+      }
+
+      uint8_t pipe = 0;
+      RF24* receiver = happens(SimAir::loss) ? NULL : find_receiver(&pipe);
+
+      //Both ends need the same packet format
+      if(receiver && (receiver->_autoAck != ack ||
+                      receiver->_dynamicPayloads != _dynamicPayloads)) {
+        receiver = NULL;
+      }
+
+      if(receiver) {
+        uint32_t arrival = micros() + SimAir::latency;
+
+        //A retry of a packet that was received is only acked again
+        bool received = receiver->_lastPid[_index % 8] == _pid;
+        if(!received && receiver->receive(pipe, data, size, arrival)) {
+          receiver->_lastPid[_index % 8] = _pid;
+          received = true;
+        }
+
+        if(!ack) {
+          return true;
+        }
+
+        if(received && !happens(SimAir::ackLoss)) {
+          Packet payload;
+          if(!happens(SimAir::emptyAck) &&
+             receiver->take_ack(pipe, &payload)) {
+            receive(0, payload.data, payload.size,
+                    arrival + SimAir::latency);
+          }
+          break;
+        }
+      } else if(!ack) {
+        return true;
+      }
+    }
+
+    //Wait out the ack, then retry
+    delayMicroseconds((_retryDelay + 1) * 250);
+  }
+
+  if(_arc >= tries) {
+    _arc = tries - 1;
+    return false;
+  }
+
+  //The ack has to get back
+  delayMicroseconds(SimAir::latency * 2);
+  return true;
+}
+
+bool RF24::writeFast(const void* buf, uint8_t len) {
+  return writeFast(buf, len, false);
+}
+
+bool RF24::writeFast(const void* buf, uint8_t len, const bool multicast) {
+  //The FIFO isn't modeled, each packet is sent right away.  A failure is
+  //kept for txStandBy().
+  if(!write(buf, len, multicast)) {
+    _fastOk = false;
+  }
+  return true;
+}
+
+bool RF24::txStandBy() {
+  bool ok = _fastOk;
+  _fastOk = true;
+  return ok;
+}
+
+bool RF24::txStandBy(uint32_t, bool) {
+  return txStandBy();
+}
+
+void RF24::startWrite(const void* buf, uint8_t len, const bool multicast) {
+  bool ok = write(buf, len, multicast);
+  _txOk = ok;
+  _txFail = !ok;
+}
+
+void RF24::whatHappened(bool& txOk, bool& txFail, bool& rxReady) {
+  txOk = _txOk;
+  txFail = _txFail;
+  rxReady = available();
+  _txOk = false;
+  _txFail = false;
+}
+
+void RF24::maskIRQ(bool, bool, bool) {
+  //The interrupt is called from a thread, there is nothing to mask
+}
+
+void RF24::openWritingPipe(const uint8_t* address) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  memcpy(_txAddress, address, 5);
+}
+
+void RF24::openReadingPipe(uint8_t number, const uint8_t* address) {
+  if(number > 5) {
+    return;
+  }
+
+  std::lock_guard<std::recursive_mutex> lock(air);
+  if(number < 2) {
+    memcpy(_pipes[number], address, 5);
+  } else {
+    _pipes[number][0] = address[0];
+  }
+  _pipeOpen[number] = true;
+}
+
+void RF24::closeReadingPipe(uint8_t pipe) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _pipeOpen[pipe] = false;
+}
+
+void RF24::writeAckPayload(uint8_t pipe, const void* buf, uint8_t len) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  if(_ackSize >= _FIFO_SIZE) {
+    return;
+  }
+
+  Packet* packet = &_ack[_ackSize++];
+  packet->pipe = pipe;
+  packet->size = min(len, 32);
+  memset(packet->data, 0, sizeof(packet->data));
+  memcpy(packet->data, buf, packet->size);
+}
+
+bool RF24::isAckPayloadAvailable() {
+  return available();
+}
+
+void RF24::enableDynamicPayloads() {
+  _dynamicPayloads = true;
+}
+
+void RF24::disableDynamicPayloads() {
+  _dynamicPayloads = false;
+  _ackPayloads = false;
+}
+
+void RF24::enableAckPayload() {
+  //Ack payloads need dynamic payloads on the real radio too
+  _ackPayloads = true;
+  _dynamicPayloads = true;
+}
+
+void RF24::setPayloadSize(uint8_t size) {
+  _payloadSize = constrain(size, 1, 32);
+}
+
+uint8_t RF24::getPayloadSize() {
+  return _payloadSize;
+}
+
+void RF24::setAutoAck(bool enable) {
+  _autoAck = enable;
+}
+
+void RF24::setChannel(uint8_t channel) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _channel = min(channel, 125);
+}
+
+uint8_t RF24::getChannel() {
+  return _channel;
+}
+
+bool RF24::setDataRate(rf24_datarate_e speed) {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _dataRate = speed;
+  return true;
+}
+
+rf24_datarate_e RF24::getDataRate() {
+  return _dataRate;
+}
+
+void RF24::setPALevel(uint8_t level) {
+  _paLevel = level;
+}
+
+uint8_t RF24::getPALevel() {
+  return _paLevel;
+}
+
+void RF24::setRetries(uint8_t delay, uint8_t count) {
+  _retryDelay = min(delay, 15);
+  _retryCount = min(count, 15);
+}
+
+uint8_t RF24::getARC() {
+  return _arc;
+}
+
+uint8_t RF24::flush_tx() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _ackSize = 0;
+  return 0;
+}
+
+uint8_t RF24::flush_rx() {
+  std::lock_guard<std::recursive_mutex> lock(air);
+  _rxSize = 0;
+  return 0;
+}
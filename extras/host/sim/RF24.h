@@ -0,0 +1,176 @@
+/*
+   RF24.h - A simulated RF24 for building RCProtocol on a host.
+
+   Every RF24 made in the program shares the same air, so a remote and a
+   device (each in its own thread) can talk to each other as they would
+   over real radios.  A packet reaches a radio that is listening on the same
+   channel and data rate, with a reading pipe open on the address it was
+   sent to.  How lossy and slow the air is, is set with SimAir.
+*/
+
+#ifndef __RF24_H__
+#define __RF24_H__
+
+#include "Arduino.h"
+
+typedef enum {
+  RF24_PA_MIN = 0, RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_ERROR
+} rf24_pa_dbm_e;
+
+typedef enum {
+  RF24_1MBPS = 0, RF24_2MBPS, RF24_250KBPS
+} rf24_datarate_e;
+
+/**
+ * The air shared by every simulated RF24
+ */
+struct SimAir {
+  //chance that a packet is lost (0 to 1)
+  static double loss;
+  //chance that the ack of a packet that arrived is lost (0 to 1).  The
+  //sender then retries, and the receiver drops the copies as a real radio
+  //does.
+  static double ackLoss;
+  //time from the end of a packet until it can be read, and again for its
+  //ack to get back (micros)
+  static uint32_t latency;
+  //chance that an ack goes back without the payload loaded for it (0 to 1).
+  //The payload is kept for the next packet, as when the receiver loads it
+  //too late.
+  static double emptyAck;
+
+  /**
+   * Seed the random loss, so runs can be repeated
+   *
+   * @param seed
+   */
+  static void seed(uint32_t seed);
+};
+
+/**
+ * The RF24 API used by RCProtocol, sent through SimAir
+ *
+ * Writes take as long as the packet would on air, including the retries.
+ */
+class RF24 {
+public:
+  RF24(uint16_t cePin = 0, uint16_t csPin = 0);
+  ~RF24();
+
+  bool begin();
+  bool isPVariant();
+  void powerUp();
+  void powerDown();
+
+  void startListening();
+  void stopListening();
+  bool available();
+  bool available(uint8_t* pipe);
+  void read(void* buf, uint8_t len);
+  uint8_t getDynamicPayloadSize();
+  bool rxFifoFull();
+
+  bool write(const void* buf, uint8_t len);
+  bool write(const void* buf, uint8_t len, const bool multicast);
+  bool writeFast(const void* buf, uint8_t len);
+  bool writeFast(const void* buf, uint8_t len, const bool multicast);
+  bool txStandBy();
+  bool txStandBy(uint32_t timeout, bool startTx = 0);
+  void startWrite(const void* buf, uint8_t len, const bool multicast);
+  void whatHappened(bool& txOk, bool& txFail, bool& rxReady);
+  void maskIRQ(bool txOk, bool txFail, bool rxReady);
+
+  void openWritingPipe(const uint8_t* address);
+  void openReadingPipe(uint8_t number, const uint8_t* address);
+  void closeReadingPipe(uint8_t pipe);
+
+  void writeAckPayload(uint8_t pipe, const void* buf, uint8_t len);
+  bool isAckPayloadAvailable();
+
+  void enableDynamicPayloads();
+  void disableDynamicPayloads();
+  void enableAckPayload();
+  void setPayloadSize(uint8_t size);
+  uint8_t getPayloadSize();
+  void setAutoAck(bool enable);
+  void setChannel(uint8_t channel);
+  uint8_t getChannel();
+  bool setDataRate(rf24_datarate_e speed);
+  rf24_datarate_e getDataRate();
+  void setPALevel(uint8_t level);
+  uint8_t getPALevel();
+  void setRetries(uint8_t delay, uint8_t count);
+  uint8_t getARC();
+  uint8_t flush_tx();
+  uint8_t flush_rx();
+
+private:
+  struct Packet {
+    uint8_t pipe;
+    uint8_t size;
+    uint8_t data[32];
+    //when the packet can be read (micros)
+    uint32_t arrival;
+  };
+
+  //the radio's 3 level FIFOs
+  static const uint8_t _FIFO_SIZE = 3;
+
+  Packet _rx[_FIFO_SIZE];
+  uint8_t _rxSize;
+  Packet _ack[_FIFO_SIZE];
+  uint8_t _ackSize;
+
+  uint8_t _pipes[6][5];
+  bool _pipeOpen[6];
+  uint8_t _txAddress[5];
+
+  bool _listening;
+  uint8_t _channel;
+  rf24_datarate_e _dataRate;
+  uint8_t _paLevel;
+  bool _autoAck;
+  bool _dynamicPayloads;
+  bool _ackPayloads;
+  uint8_t _payloadSize;
+  uint8_t _retryDelay;
+  uint8_t _retryCount;
+  uint8_t _arc;
+
+  //packet id, so a retried packet isn't received twice
+  uint32_t _pid;
+  //the last packet received from each radio, to drop retries
+  uint32_t _lastPid[8];
+  uint8_t _index;
+
+  bool _fastOk;
+  bool _txOk;
+  bool _txFail;
+
+  /**
+   * Find the radio and pipe a packet from this radio would reach
+   *
+   * @param pipe set to the pipe that matches
+   *
+   * @return the radio, or NULL if no radio is listening for it
+   */
+  RF24* find_receiver(uint8_t* pipe);
+  /**
+   * Put a packet in the RX FIFO
+   *
+   * @return false if the FIFO is full
+   */
+  bool receive(uint8_t pipe, const void* data, uint8_t size, uint32_t arrival);
+  /**
+   * Take the ack payload loaded for a pipe
+   *
+   * @return false if there was none
+   */
+  bool take_ack(uint8_t pipe, Packet* packet);
+  /**
+   * Time a packet is on the air, including the radio settling (micros)
+   */
+  uint32_t air_time(uint8_t size);
+};
+
+#endif
@@ -0,0 +1,10 @@
+/*
+   printf.h - On the host, printf already goes to stdout.
+*/
+
+#ifndef __PRINTF_H__
+#define __PRINTF_H__
+
+inline void printf_begin() {}
+
+#endif
@@ -5,11 +5,79 @@
 
 DeviceProtocol::DeviceProtocol(RF24* tranceiver, const uint8_t deviceId[]) {
   _isConnected = false;
+  _nextPacket = _NO_PACKET;
+  _frameToggle = 0;
+  _keyframeToggle = 0;
+  _codedFrame = 0;
+  _codedMask = 0;
+  _hasKeyframe = false;
+  _hasArrival = false;
+  _lastArrival = 0;
+  _failsafe = NULL;
+  _lastFrameTime = 0;
+  _frameGap = 1;
+  _framesKept = 0;
+  _channelState = RC_CHANNELS_LIVE;
+  _interpLatency = 0;
+  _interpStart = 0;
+  _interpReady = false;
+  _lastSequence = 0;
+  _sequenceTime = 0;
+  _hasSequence = false;
+  _framesMissed = 0;
+  _frameLatency = 0;
+  _adapted = false;
+  _adaptTimer = 0;
+  _hopFrame = 0;
+  _hopTime = 0;
+  _hopSynced = false;
+  _hopChannel = 0;
+  _settingsTrial = false;
+  _settingsTimer = 0;
+  _ackSize = 0;
+  _ackPending = 0;
+  _streamData = NULL;
+  _streamSize = 0;
+  _streamOffset = 0;
+  _streamLoaded = 0;
+  _streamSequence = 0;
+  _streamTurn = false;
 
   for(uint8_t i = 0; i < 5; i++) {
     _remoteId[i] = 0;
   }
 
+  for(uint8_t i = 0; i < 32; i++) {
+    _newSettings[i] = 0;
+    _oldSettings[i] = 0;
+  }
+
+  for(uint8_t i = 0; i < RC_MAX_CHANNELS; i++) {
+    _lastFrame[i] = 0;
+    _prevFrame[i] = 0;
+    _interpFrom[i] = 0;
+    _interpTo[i] = 0;
+  }
+
+  _pairPipe = 1;
+
+  _interruptMode = false;
+  _rxHead = 0;
+  _rxTail = 0;
+  _rxPending = false;
+  for(uint8_t i = 0; i < _MAX_PEERS; i++) {
+    _peers[i].channels = NULL;
+    _peers[i].telemetry = NULL;
+    _peers[i].telemetrySize = 0;
+    _peers[i].attached = false;
+    _peers[i].connected = false;
+    _peers[i].updated = false;
+    _peers[i].hasKeyframe = false;
+  }
+
+  _saveRemoteID = NULL;
+  _setConnected = NULL;
+
   _radio = tranceiver;
   _deviceId = deviceId;
 
@@ -32,20 +100,40 @@ int8_t DeviceProtocol::begin(RCSettings* settings,
 
     _radio->openWritingPipe(id);
     _radio->openReadingPipe(1, _deviceId);
+    open_peers();
+
+    for(uint8_t i = 0; i < 5; i++) {
+      _remoteId[i] = id[i];
+    }
 
     _radio->startListening();
+    hop_reset();
 
     /*If the remote is still connected, it should be sending regular data
     _settings.getCommsFrequency() per second, so we will wait for 3 time
-    periods before giving up.*/
-    if(wait_till_available(round(3000.0 / _settings.getCommsFrequency())) == -1) {
+    periods before giving up.  When hopping, the remote may first have to
+    come around to the first channel of the sequence.  If the remote was also
+    reset, it tries to resume for RC_CONNECT_TIMEOUT, so wait at least as
+    long.*/
+    uint16_t periods = 3;
+    if(_settings.getHopInterval() > 0) {
+      periods += frame_cycle();
+    }
+    unsigned long timeout = round(1000.0 * periods /
+                                  _settings.getCommsFrequency());
+    if(wait_till_available(max(timeout, (unsigned long)RC_CONNECT_TIMEOUT)) == -1) {
       return -1;
     }
 
-    for(uint8_t i = 0; i < 5; i++) {
-      _remoteId[i] = id[i];
-    }
     _isConnected = true;
+    _hasKeyframe = false;
+    _hasArrival = false;
+    _adapted = false;
+    _settingsTrial = false;
+    _ackSize = 0;
+    _ackPending = 0;
+    restart_stream();
+    restart_interrupt();
 
 
     return 1;
@@ -55,13 +143,25 @@ int8_t DeviceProtocol::begin(RCSettings* settings,
   return 0;
 }
 
-int8_t DeviceProtocol::pair(DeviceProtocol::saveRemoteID saveRemoteID) {
+int8_t DeviceProtocol::pair(DeviceProtocol::saveRemoteID saveRemoteID,
+                            uint8_t pipe) {
+  int8_t status = beginPair(saveRemoteID, pipe);
+
+  while(status == RC_INFO_HANDSHAKE_PENDING) {
+    status = pollHandshake();
+  }
+
+  return status;
+}
+
+int8_t DeviceProtocol::beginPair(DeviceProtocol::saveRemoteID saveRemoteID,
+                                 uint8_t pipe) {
   if(isConnected()) {
     return RC_ERROR_ALREADY_CONNECTED;
   }
 
-  uint8_t radioId[5];
-  bool sent = false;
+  _saveRemoteID = saveRemoteID;
+  _pairPipe = constrain(pipe, 1, _PEER_PIPE + _MAX_PEERS - 1);
 
   //Set the PA level to low as the pairing devices are going to be fairly
   //close to each other.
@@ -77,53 +177,31 @@ int8_t DeviceProtocol::pair(DeviceProtocol::saveRemoteID saveRemoteID) {
   //clear the buffer of any unread messages.
   flush_buffer();
 
-  //wait until data is available from the remote
-  if(wait_till_available(RC_TIMEOUT) != 0) {
-    return RC_ERROR_TIMEOUT;
-  }
-
-  //Read the Radio's ID
-  _radio->read(&radioId, 5);
-
-  //write to the remote the device id
-  saveRemoteID(radioId);
+  handshake_step(_PAIR_WAIT_ID);
 
-  _radio->stopListening();
-
-  //Now that we know who we will write to, open the writing pipe
-  _radio->openWritingPipe(radioId);
-
-  //Delay so that the remote has time to start listening
-  delay(200);
-
-  //Send the device id to the remote
-  sent = _radio->write(const_cast<uint8_t*>(_deviceId), 5);
-  if(!sent) {
-    return RC_ERROR_LOST_CONNECTION;
-  }
+  return RC_INFO_HANDSHAKE_PENDING;
+}
 
-  delay(200);
+int8_t DeviceProtocol::connect(DeviceProtocol::loadRemoteID loadRemoteID,
+                               DeviceProtocol::setConnected setConnected) {
+  int8_t status = beginConnect(loadRemoteID, setConnected);
 
-  //Send the settings to the remote
-  sent = _radio->write(const_cast<uint8_t*>(_settings.getSettings()), 32);
-  if(!sent) {
-    return RC_ERROR_LOST_CONNECTION;
+  while(status == RC_INFO_HANDSHAKE_PENDING) {
+    status = pollHandshake();
   }
 
-  return 0;
+  return status;
 }
 
-int8_t DeviceProtocol::connect(DeviceProtocol::loadRemoteID loadRemoteID,
-                               DeviceProtocol::setConnected setConnected) {
+int8_t DeviceProtocol::beginConnect(DeviceProtocol::loadRemoteID loadRemoteID,
+                                    DeviceProtocol::setConnected setConnected) {
   if(isConnected()) {
     return RC_ERROR_ALREADY_CONNECTED;
   }
 
-  uint8_t connectSuccess = 0;
-  uint8_t test = 0;
+  _setConnected = setConnected;
 
-  uint8_t remoteId[5];
-  loadRemoteID(remoteId);
+  loadRemoteID(_remoteId);
 
   //reset connected because if we fail connecting, we will not be connected
   //to anything.
@@ -133,7 +211,7 @@ int8_t DeviceProtocol::connect(DeviceProtocol::loadRemoteID loadRemoteID,
 
   apply_settings(&_pairSettings);
 
-  _radio->openWritingPipe(remoteId);
+  _radio->openWritingPipe(_remoteId);
   _radio->openReadingPipe(1, _deviceId);
 
   flush_buffer();
@@ -142,94 +220,198 @@ int8_t DeviceProtocol::connect(DeviceProtocol::loadRemoteID loadRemoteID,
   _radio->stopListening();
 
   //send the device id to the remote, this announces who we are.
-  if(force_send(const_cast<uint8_t*>(_deviceId), 5, RC_TIMEOUT) != 0) {
-    return RC_ERROR_TIMEOUT;
-  }
+  start_send(_deviceId, 5);
+  handshake_step(_CONNECT_SEND_ID);
 
-  _radio->startListening();
+  return RC_INFO_HANDSHAKE_PENDING;
+}
 
-  //Wait until a response is made
-  if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-    return RC_ERROR_LOST_CONNECTION;
+int8_t DeviceProtocol::pollHandshake() {
+  if(_handshakeState == _HANDSHAKE_IDLE) {
+    return isConnected() ? 0 : RC_ERROR_NOT_CONNECTED;
   }
 
-  _radio->read(&connectSuccess, 1);
+  if(_handshakeState < _CONNECT_SEND_ID) {
+    return poll_pair();
+  }
+  return poll_connect();
+}
 
-  _radio->stopListening();
+int8_t DeviceProtocol::handshake_end(int8_t status) {
+  _handshakeState = _HANDSHAKE_IDLE;
+  return status;
+}
 
-  //check if the connection was successful
-  if(connectSuccess == _NACK) {
-    return RC_ERROR_CONNECTION_REFUSED;
-  } else if(connectSuccess != _ACK) {
-    return RC_ERROR_BAD_DATA;
-  }
+int8_t DeviceProtocol::poll_pair() {
+  uint8_t address[5];
+  int8_t sent;
 
-  apply_settings(&_settings);
+  switch(_handshakeState) {
+  case _PAIR_WAIT_ID:
+    //wait until data is available from the remote
+    if(_radio->available()) {
+      //Read the Radio's ID
+      _radio->read(&_remoteId, 5);
 
-  _radio->setPALevel(RF24_PA_HIGH);
+      //write to the remote the device id
+      _saveRemoteID(_remoteId);
 
-  _radio->startListening();
+      _radio->stopListening();
+
+      //Now that we know who we will write to, open the writing pipe
+      _radio->openWritingPipe(_remoteId);
 
+      //Send the device id to the remote, peers are given the pipe's address.
+      //It is sent as soon as the remote starts listening.
+      pipe_address(_pairPipe, address);
+      start_send(address, 5);
+      handshake_step(_PAIR_SEND_ID);
+    } else if(handshake_timeout(RC_TIMEOUT)) {
+      return handshake_end(RC_ERROR_TIMEOUT);
+    }
+    break;
 
-  if(_settings.getEnableAck()) {
-    if(_settings.getEnableAckPayload()) {
-      _radio->writeAckPayload(1, &_TEST, 1);
+  case _PAIR_SEND_ID:
+    sent = check_send();
 
-      if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-        _radio->stopListening();
-        return RC_ERROR_LOST_CONNECTION;
+    if(sent == -1) {
+      if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+        return handshake_end(RC_ERROR_LOST_CONNECTION);
       }
+      //The remote isn't listening yet, try again.
+      pipe_address(_pairPipe, address);
+      start_send(address, 5);
+    } else if(sent == 1) {
+      //The remote is still listening, so send the settings right away
+      start_send(_settings.getSettings(), 32);
+      handshake_step(_PAIR_SEND_SETTINGS);
+    }
+    break;
 
-      _radio->read(&test, 1);
+  case _PAIR_SEND_SETTINGS:
+    sent = check_send();
 
-      if(test != _TEST) {
-        _radio->stopListening();
-        return RC_ERROR_BAD_DATA;
+    if(sent == -1) {
+      if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+        return handshake_end(RC_ERROR_LOST_CONNECTION);
       }
+      start_send(_settings.getSettings(), 32);
+    } else if(sent == 1) {
+      return handshake_end(0);
+    }
+    break;
+  }
 
-    } else {
-      if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-        _radio->stopListening();
-        return RC_ERROR_LOST_CONNECTION;
+  return RC_INFO_HANDSHAKE_PENDING;
+}
+
+int8_t DeviceProtocol::poll_connect() {
+  uint8_t connectSuccess = 0;
+  uint8_t test = 0;
+  int8_t sent;
+
+  switch(_handshakeState) {
+  case _CONNECT_SEND_ID:
+    sent = check_send();
+
+    if(sent == 1) {
+      _radio->startListening();
+
+      //Wait until a response is made
+      handshake_step(_CONNECT_WAIT_REPLY);
+    } else if(handshake_timeout(RC_TIMEOUT)) {
+      _radio->flush_tx();
+      return handshake_end(RC_ERROR_TIMEOUT);
+    } else if(sent == -1) {
+      //The remote isn't listening yet, try again.
+      start_send(_deviceId, 5);
+    }
+    break;
+
+  case _CONNECT_WAIT_REPLY:
+    if(_radio->available()) {
+      _radio->read(&connectSuccess, 1);
+
+      _radio->stopListening();
+
+      //check if the connection was successful
+      if(connectSuccess == _NACK) {
+        return handshake_end(RC_ERROR_CONNECTION_REFUSED);
+      } else if(connectSuccess != _ACK) {
+        return handshake_end(RC_ERROR_BAD_DATA);
+      }
+
+      apply_settings(&_settings);
+
+      _radio->setPALevel(RF24_PA_HIGH);
+
+      _radio->startListening();
+
+      if(_settings.getEnableAck() && _settings.getEnableAckPayload()) {
+        _radio->writeAckPayload(1, &_TEST, 1);
       }
 
+      handshake_step(_CONNECT_WAIT_TEST);
+    } else if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+      _radio->stopListening();
+      return handshake_end(RC_ERROR_LOST_CONNECTION);
+    }
+    break;
+
+  case _CONNECT_WAIT_TEST:
+    if(_radio->available()) {
       _radio->read(&test, 1);
 
       if(test != _TEST) {
         _radio->stopListening();
-        return RC_ERROR_BAD_DATA;
+        return handshake_end(RC_ERROR_BAD_DATA);
       }
-    }
-  } else {
-    if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-      _radio->stopListening();
-      return RC_ERROR_LOST_CONNECTION;
-    }
 
-    _radio->read(&test, 1);
+      if(_settings.getEnableAck()) {
+        return handshake_end(connect_finish());
+      }
 
-    if(test != _TEST) {
+      //Without acks, the test is sent back to the remote, which is already
+      //listening for it.
       _radio->stopListening();
-      return RC_ERROR_BAD_DATA;
+      start_send(&_TEST, 1);
+      handshake_step(_CONNECT_SEND_TEST);
+    } else if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+      _radio->stopListening();
+      return handshake_end(RC_ERROR_LOST_CONNECTION);
     }
+    break;
 
-    _radio->stopListening();
-
-    delay(200);
-
-    _radio->write(&_TEST, 1);
-
-    _radio->startListening();
+  case _CONNECT_SEND_TEST:
+    //Without acks there is no way to know if the test arrived.  If it
+    //didn't, the remote tests again, and update() answers it.
+    if(check_send() != 0) {
+      _radio->startListening();
 
+      return handshake_end(connect_finish());
+    }
+    break;
   }
 
+  return RC_INFO_HANDSHAKE_PENDING;
+}
+
+int8_t DeviceProtocol::connect_finish() {
   //We passed all of the tests, so we are connected.
   _isConnected = true;
-  setConnected(true);
-
-  for(uint8_t i = 0; i < 5; i++) {
-    _remoteId[i] = remoteId[i];
-  }
+  _hasKeyframe = false;
+  _hasArrival = false;
+  _adapted = false;
+  _settingsTrial = false;
+  _ackSize = 0;
+  _ackPending = 0;
+  restart_stream();
+  //Start with an empty ack FIFO, so it only holds the link's telemetry
+  _radio->flush_tx();
+  hop_reset();
+  open_peers();
+  restart_interrupt();
+  _setConnected(true);
 
   return 0;
 }
@@ -239,96 +421,1243 @@ bool DeviceProtocol::isConnected() {
 }
 
 int8_t DeviceProtocol::check_packet(void* returnData, uint8_t dataSize,
-                                    void* telemetry, uint8_t telemetrySize) {
+                                    uint8_t* pipe, uint32_t* time) {
   if(!isConnected()) {
     return RC_ERROR_NOT_CONNECTED;
   }
 
-  uint8_t pipe = 0;
+  if(_interruptMode) {
+    //Now that there may be room, read what the interrupt had to leave
+    if(_rxPending) {
+      noInterrupts();
+      read_fifo(micros());
+      interrupts();
+    }
+
+    if(_rxTail == _rxHead) {
+      return 0;
+    }
+
+    RxPacket* packet = &_rxBuffer[_rxTail];
+    uint8_t size = min(packet->size, dataSize);
+
+    for(uint8_t i = 0; i < dataSize; i++) {
+      ((uint8_t*)returnData)[i] = i < size ? packet->data[i] : 0;
+    }
+    *pipe = packet->pipe;
+    *time = packet->time;
+
+    _rxTail = (_rxTail + 1) % RC_RX_BUFFER;
+
+    return 1;
+  }
 
-  if(_radio->available(&pipe)) {
-    _radio->read(returnData, dataSize);
+  if(_radio->available(pipe)) {
+    uint8_t size = dataSize;
+    *time = micros();
 
-    //Check if the telemetry should be sent through the ackPayload
-    if(telemetry && _settings.getEnableAckPayload()) {
-      _radio->writeAckPayload(pipe, telemetry, telemetrySize);
+    //Dynamic payloads can be shorter than dataSize, so clear the rest
+    if(_settings.getEnableDynamicPayload()) {
+      size = _radio->getDynamicPayloadSize();
+      size = min(size, dataSize);
+      for(uint8_t i = size; i < dataSize; i++) {
+        ((uint8_t*)returnData)[i] = 0;
+      }
     }
 
+    _radio->read(returnData, size);
+
     return 1;
   }
 
   return 0;
 }
 
-int8_t DeviceProtocol::check_packet(void* returnData, uint8_t dataSize) {
-  return check_packet(returnData, dataSize, NULL, 0);
+void DeviceProtocol::setInterruptMode(bool enable) {
+  _interruptMode = enable;
+  _rxHead = 0;
+  _rxTail = 0;
+  _rxPending = false;
+
+  //Only interrupt when a packet is received
+  _radio->maskIRQ(enable, enable, false);
+
+  restart_interrupt();
+}
+
+void DeviceProtocol::handleInterrupt() {
+  uint32_t time = micros();
+
+  if(!_interruptMode || !isConnected() || _handshakeState != _HANDSHAKE_IDLE) {
+    return;
+  }
+
+  //Clear the interrupt first, so a packet that arrives while reading will
+  //interrupt again.
+  bool sent, failed, received;
+  _radio->whatHappened(sent, failed, received);
+
+  read_fifo(time);
+}
+
+void DeviceProtocol::read_fifo(uint32_t time) {
+  uint8_t pipe = 0;
+
+  while(_radio->available(&pipe)) {
+    uint8_t next = (_rxHead + 1) % RC_RX_BUFFER;
+
+    //Leave the rest in the radio until update() makes room
+    if(next == _rxTail) {
+      _rxPending = true;
+      return;
+    }
+
+    RxPacket* packet = &_rxBuffer[_rxHead];
+    packet->size = _settings.getPayloadSize();
+    if(_settings.getEnableDynamicPayload()) {
+      packet->size = _radio->getDynamicPayloadSize();
+      packet->size = min(packet->size, sizeof(packet->data));
+    }
+    packet->pipe = pipe;
+    packet->time = time;
+
+    _radio->read(packet->data, packet->size);
+
+    _rxHead = next;
+  }
+
+  _rxPending = false;
+}
+
+void DeviceProtocol::restart_interrupt() {
+  if(!_interruptMode || !isConnected()) {
+    return;
+  }
+
+  noInterrupts();
+  bool sent, failed, received;
+  _radio->whatHappened(sent, failed, received);
+  read_fifo(micros());
+  interrupts();
+}
+
+void DeviceProtocol::load_telemetry(uint8_t telemetry[],
+                                    uint8_t telemetrySize) {
+  //Check if the telemetry should be sent through the ackPayload
+  if(!_settings.getEnableAck() || !_settings.getEnableAckPayload()) {
+    return;
+  }
+
+  //A packet that hasn't been read may have taken a payload, so wait until
+  //it has been read to know which pipes need loading.
+  if(packet_waiting()) {
+    return;
+  }
+
+  if(!(_ackPending & (1 << 1))) {
+    //Take turns between the stream and telemetry, so neither is held up
+    if(_streamData && (_streamTurn || !telemetry)) {
+      _ackSize = build_fragment(_ack);
+    } else if(telemetry) {
+      _ackSize = build_telemetry(_ack, telemetry, telemetrySize);
+    } else {
+      _ackSize = 0;
+    }
+    _streamTurn = !_streamTurn;
+
+    if(_ackSize > 0) {
+      write_ack();
+    }
+
+    //A fragment is sent as it is, only telemetry gets old.
+  } else if(telemetry && _streamLoaded == 0) {
+    uint8_t ack[32];
+    uint8_t size = build_telemetry(ack, telemetry, telemetrySize);
+
+    if(size != _ackSize || memcmp(ack, _ack, size) != 0) {
+      memcpy(_ack, ack, size);
+      _ackSize = size;
+
+      //The radio can't replace a payload, so clear the FIFO and load the
+      //payload of every pipe again.
+      _radio->flush_tx();
+      _ackPending = 0;
+      write_ack();
+    }
+  }
+
+  //Peers don't get the stream, but still need the header
+  for(uint8_t i = 0; i < _MAX_PEERS; i++) {
+    Peer* peer = &_peers[i];
+    uint8_t pipe = _PEER_PIPE + i;
+
+    if(peer->attached && peer->telemetry && !(_ackPending & (1 << pipe))) {
+      uint8_t ack[32];
+      uint8_t size = build_telemetry(ack, peer->telemetry, peer->telemetrySize,
+                                     false);
+      _radio->writeAckPayload(pipe, ack, size);
+      _ackPending |= 1 << pipe;
+    }
+  }
+}
+
+bool DeviceProtocol::packet_waiting() {
+  //handleInterrupt() reads every packet into the ring, so there is no need
+  //to ask the radio
+  if(_interruptMode) {
+    return _rxTail != _rxHead || _rxPending;
+  }
+  return _radio->available();
+}
+
+void DeviceProtocol::ack_delivered(uint8_t pipe) {
+  if(!(_ackPending & (1 << pipe))) {
+    return;
+  }
+  _ackPending &= ~(1 << pipe);
+
+  if(pipe != 1) {
+    return;
+  }
+  _stats.ackPayloads++;
+
+  if(_streamLoaded > 0) {
+    _streamOffset += _streamLoaded;
+    _streamLoaded = 0;
+    _streamSequence = (_streamSequence + 1) & _STREAM_SEQUENCE;
+    if(_streamOffset >= _streamSize) {
+      _streamData = NULL;
+    }
+  }
+}
+
+void DeviceProtocol::reload_telemetry() {
+  //Stopping the radio clears every ack payload, so only the one for pipe 1
+  //is left to load.  The peers are loaded again by the next update().
+  _ackPending &= 1 << 1;
+
+  if(_ackPending) {
+    write_ack();
+  }
+}
+
+void DeviceProtocol::write_ack() {
+  _radio->writeAckPayload(1, _ack, _ackSize);
+  _ackPending |= 1 << 1;
+
+  //If a packet came in while loading, there is no telling if it took the
+  //payload.  Clear it so it is loaded again once the packet is read, a
+  //fragment sent twice is dropped by the remote.
+  if(packet_waiting()) {
+    _radio->flush_tx();
+    _ackPending = 0;
+  }
+}
+
+uint8_t DeviceProtocol::build_telemetry(uint8_t* ack, void* telemetry,
+                                        uint8_t telemetrySize, bool timing) {
+  uint8_t header = 0;
+  if(_settings.getEnableStream()) {
+    ack[header++] = _STREAM_TELEMETRY;
+  }
+
+  //Tell the remote when its last frame arrived, so it can sync the link
+  //clock.  A time of 0 is ignored.
+  if(_settings.getEnableTimestamps()) {
+    bool known = timing && _hasSequence;
+    ack[header] = known ? _lastSequence : 0;
+    write_time(ack + header + 1, known ? _sequenceTime : 0);
+    header += _ACK_TIMING_SIZE;
+  }
+
+  //The payload may only have room for the header
+  uint8_t room = 0;
+  if(_settings.getPayloadSize() > header) {
+    room = _settings.getPayloadSize() - header;
+  }
+
+  uint8_t size = min(telemetrySize, room);
+  memcpy(ack + header, telemetry, size);
+
+  return size + header;
+}
+
+uint8_t DeviceProtocol::build_fragment(uint8_t* ack) {
+  uint16_t remaining = _streamSize - _streamOffset;
+  uint8_t size = min(remaining, _settings.getPayloadSize() - 2);
+
+  ack[0] = _STREAM_FRAGMENT | _streamSequence;
+  if(_streamOffset == 0) {
+    ack[0] |= _STREAM_FIRST;
+  }
+  if(size == remaining) {
+    ack[0] |= _STREAM_LAST;
+  }
+  ack[1] = size;
+  memcpy(ack + 2, _streamData + _streamOffset, size);
+
+  _streamLoaded = size;
+
+  return size + 2;
+}
+
+void DeviceProtocol::restart_stream() {
+  //A fragment may have been lost with the connection, so send the message
+  //again from the start.
+  _streamOffset = 0;
+  _streamLoaded = 0;
+  _streamTurn = false;
+}
+
+bool DeviceProtocol::writeStream(const uint8_t data[], uint16_t size) {
+  if(!_settings.getEnableStream() || !_settings.getEnableAck() ||
+     !_settings.getEnableAckPayload() || _streamData) {
+    return false;
+  }
+
+  if(size > 0) {
+    _streamData = data;
+    _streamSize = size;
+    _streamOffset = 0;
+    _streamLoaded = 0;
+  }
+
+  return true;
+}
+
+uint16_t DeviceProtocol::getStreamRemaining() {
+  if(!_streamData) {
+    return 0;
+  }
+  return _streamSize - _streamOffset;
+}
+
+void DeviceProtocol::pipe_address(uint8_t pipe, uint8_t* address) {
+  for(uint8_t i = 0; i < 5; i++) {
+    address[i] = _deviceId[i];
+  }
+  address[0] += pipe - 1;
+}
+
+void DeviceProtocol::open_peers() {
+  uint8_t address[5];
+
+  for(uint8_t i = 0; i < _MAX_PEERS; i++) {
+    if(_peers[i].attached) {
+      pipe_address(_PEER_PIPE + i, address);
+      _radio->openReadingPipe(_PEER_PIPE + i, address);
+    }
+  }
+}
+
+int8_t DeviceProtocol::attachPeer(uint8_t pipe, uint16_t channels[],
+                                  uint8_t telemetry[], uint8_t telemetrySize) {
+  if(pipe < _PEER_PIPE || pipe >= _PEER_PIPE + _MAX_PEERS) {
+    return -1;
+  }
+
+  //The peer's address is only known from pairing, so there is nowhere to
+  //send replies without acks, and peers can't follow the main remote's
+  //changes to the link.
+  if(!_settings.getEnableAck() || packets_per_frame(&_settings) > 1 ||
+      _settings.getHopInterval() > 0 || _settings.getEnableAdaptive()) {
+    return -1;
+  }
+
+  Peer* peer = &_peers[pipe - _PEER_PIPE];
+  peer->channels = channels;
+  peer->telemetry = telemetry;
+  peer->telemetrySize = min(telemetrySize, _settings.getPayloadSize());
+  peer->attached = true;
+  peer->connected = false;
+  peer->updated = false;
+  peer->hasKeyframe = false;
+
+  if(isConnected()) {
+    uint8_t address[5];
+    pipe_address(pipe, address);
+    _radio->openReadingPipe(pipe, address);
+  }
+
+  return 0;
+}
+
+void DeviceProtocol::detachPeer(uint8_t pipe) {
+  if(pipe < _PEER_PIPE || pipe >= _PEER_PIPE + _MAX_PEERS) {
+    return;
+  }
+
+  _peers[pipe - _PEER_PIPE].attached = false;
+  _peers[pipe - _PEER_PIPE].connected = false;
+  _radio->closeReadingPipe(pipe);
+
+  //Don't leave the peer's telemetry taking up room in the ack FIFO
+  if(_ackPending & (1 << pipe)) {
+    _radio->flush_tx();
+    _ackPending = 0;
+  }
+}
+
+bool DeviceProtocol::isPeerConnected(uint8_t pipe) {
+  if(pipe < _PEER_PIPE || pipe >= _PEER_PIPE + _MAX_PEERS) {
+    return false;
+  }
+  return _peers[pipe - _PEER_PIPE].connected;
+}
+
+bool DeviceProtocol::pollPeer(uint8_t pipe) {
+  if(pipe < _PEER_PIPE || pipe >= _PEER_PIPE + _MAX_PEERS) {
+    return false;
+  }
+
+  bool updated = _peers[pipe - _PEER_PIPE].updated;
+  _peers[pipe - _PEER_PIPE].updated = false;
+  return updated;
+}
+
+void DeviceProtocol::read_peer(uint8_t pipe, uint8_t* packet) {
+  Peer* peer = &_peers[pipe - _PEER_PIPE];
+
+  if(!peer->attached) {
+    return;
+  }
+
+  //Anything but a disconnect means the peer is there
+  peer->connected = packet[0] != _PACKET_DISCONNECT;
+
+  if((packet[0] & 0xF0) == _PACKET_CHANNELS) {
+    //Peers only send frames of one packet
+    unpack_channels(packet + channel_header(&_settings), peer->channels,
+                    channels_per_packet(&_settings),
+                    _settings.getChannelResolution());
+    peer->hasKeyframe = true;
+    peer->updated = true;
+  } else if((packet[0] & ~_PACKET_CHANNELS_TOGGLE) == _PACKET_CHANNELS_DELTA &&
+            peer->hasKeyframe) {
+    read_delta(packet, peer->channels);
+    peer->updated = true;
+  } else if(packet[0] == _PACKET_CHANNELS_PRIMARY && peer->hasKeyframe) {
+    read_primary(packet, peer->channels);
+    peer->updated = true;
+  } else if(packet[0] == _PACKET_DISCONNECT) {
+    peer->hasKeyframe = false;
+  }
+}
+
+bool DeviceProtocol::read_channels(uint8_t* packet, uint16_t channels[]) {
+  uint8_t perPacket = channels_per_packet(&_settings);
+  uint8_t packets = packets_per_frame(&_settings);
+  uint8_t index = packet[0] & _PACKET_CHANNELS_INDEX;
+  uint8_t toggle = packet[0] & _PACKET_CHANNELS_TOGGLE;
+
+  if(parity_packet(&_settings)) {
+    return read_coded(packet, channels);
+  }
+
+  //Single packet frames go straight to the channels
+  if(packets == 1) {
+    unpack_channels(packet + channel_header(&_settings), channels, perPacket,
+                    _settings.getChannelResolution());
+    _hasKeyframe = true;
+    _keyframeToggle = toggle;
+    return true;
+  }
+
+  //A packet of this frame that was already read was sent again
+  if(_nextPacket != _NO_PACKET && index > 0 && index < _nextPacket &&
+     toggle == _frameToggle) {
+    return false;
+  }
+
+  //The first packet of a frame starts a new frame
+  if(index == 0) {
+    _frameToggle = toggle;
+    _nextPacket = 0;
+  }
+
+  //Packets must come in order from the same frame, otherwise the frame is
+  //dropped and we wait for the start of the next frame.
+  if(index != _nextPacket || toggle != _frameToggle) {
+    _nextPacket = _NO_PACKET;
+    return false;
+  }
+
+  uint8_t first = index * perPacket;
+  if(first < RC_MAX_CHANNELS) {
+    unpack_channels(packet + channel_header(&_settings), _frame + first,
+                    min(perPacket, RC_MAX_CHANNELS - first),
+                    _settings.getChannelResolution());
+  }
+
+  if(++_nextPacket < packets) {
+    return false;
+  }
+
+  //The frame is complete, so deliver every channel at once
+  _nextPacket = _NO_PACKET;
+  for(uint8_t i = 0; i < min(_settings.getNumChannels(), RC_MAX_CHANNELS); i++) {
+    channels[i] = _frame[i];
+  }
+  _hasKeyframe = true;
+  _keyframeToggle = packet[0] & _PACKET_CHANNELS_TOGGLE;
+
+  return true;
+}
+
+bool DeviceProtocol::read_coded(uint8_t* packet, uint16_t channels[]) {
+  uint8_t perPacket = channels_per_packet(&_settings);
+  uint8_t packets = packets_per_frame(&_settings);
+  uint8_t header = channel_header(&_settings);
+  uint8_t index = packet[0] & _PACKET_CHANNELS_INDEX;
+  uint8_t all = (1 << packets) - 1;
+
+  if(index > packets) {
+    return false;
+  }
+
+  //A packet of a new frame drops what is left of the last one
+  if(_codedMask == 0 || packet[1] != _codedFrame) {
+    _codedFrame = packet[1];
+    _codedMask = 0;
+    for(uint8_t i = 0; i < sizeof(_parity); i++) {
+      _parity[i] = 0;
+    }
+  }
+
+  //The frame was already delivered, or the packet was sent twice
+  if((_codedMask & all) == all || (_codedMask & (1 << index))) {
+    return false;
+  }
+  _codedMask |= 1 << index;
+
+  for(uint8_t i = header; i < _settings.getPayloadSize(); i++) {
+    _parity[i - header] ^= packet[i];
+  }
+
+  if(index < packets) {
+    uint8_t first = index * perPacket;
+    if(first < RC_MAX_CHANNELS) {
+      unpack_channels(packet + header, _frame + first,
+                      min(perPacket, RC_MAX_CHANNELS - first),
+                      _settings.getChannelResolution());
+    }
+  }
+
+  uint8_t missing = all & ~_codedMask;
+
+  //With the parity packet, the XOR of every packet read is the one missing
+  if((_codedMask & (1 << packets)) && missing != 0 &&
+     (missing & (missing - 1)) == 0) {
+    uint8_t lost = 0;
+    while(!(missing & (1 << lost))) {
+      lost++;
+    }
+
+    uint8_t first = lost * perPacket;
+    if(first < RC_MAX_CHANNELS) {
+      unpack_channels(_parity, _frame + first,
+                      min(perPacket, RC_MAX_CHANNELS - first),
+                      _settings.getChannelResolution());
+    }
+    _codedMask |= missing;
+    _stats.framesRecovered++;
+  }
+
+  if((_codedMask & all) != all) {
+    return false;
+  }
+
+  //The frame is complete, so deliver every channel at once
+  for(uint8_t i = 0; i < min(_settings.getNumChannels(), RC_MAX_CHANNELS); i++) {
+    channels[i] = _frame[i];
+  }
+  _hasKeyframe = true;
+  _keyframeToggle = packet[0] & _PACKET_CHANNELS_TOGGLE;
+
+  return true;
+}
+
+void DeviceProtocol::read_delta(uint8_t* packet, uint16_t channels[]) {
+  uint8_t numChannels = min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+  uint8_t maskSize = (numChannels + 7) / 8;
+  uint8_t* mask = packet + channel_header(&_settings);
+  uint16_t changed[RC_MAX_CHANNELS];
+  uint8_t numChanged = 0;
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    if(mask[i / 8] & (0x80 >> (i % 8))) {
+      numChanged++;
+    }
+  }
+
+  //Unpack the changed channels, then move them to where they belong
+  unpack_channels(mask + maskSize, changed, numChanged,
+                  _settings.getChannelResolution());
+
+  numChanged = 0;
+  for(uint8_t i = 0; i < numChannels; i++) {
+    if(mask[i / 8] & (0x80 >> (i % 8))) {
+      channels[i] = changed[numChanged++];
+    }
+  }
+}
+
+void DeviceProtocol::read_primary(uint8_t* packet, uint16_t channels[]) {
+  unpack_channels(packet + channel_header(&_settings), channels,
+                  primary_channels(&_settings),
+                  _settings.getChannelResolution());
+}
+
+void DeviceProtocol::set_link(rf24_datarate_e dataRate, uint8_t paLevel) {
+  _radio->stopListening();
+  _radio->setDataRate(dataRate);
+  _radio->setPALevel(paLevel);
+  _radio->startListening();
+
+  _adapted = dataRate != _settings.getDataRate() || paLevel != RF24_PA_HIGH;
+  _adaptTimer = millis();
+
+  reload_telemetry();
+}
+
+bool DeviceProtocol::read_resume(uint8_t* packet) {
+  uint8_t* settings = _settings.getSettings();
+  uint8_t nonce = packet[1];
+  bool valid = packet[2] == checksum(settings, 32, nonce);
+
+  uint8_t reply[2] = {valid ? _ACK : _NACK, checksum(settings, 32, ~nonce)};
+  send_reply(reply, 2);
+
+  //The remote starts again from the first frame of the hop sequence, with
+  //a keyframe
+  if(valid) {
+    _hasKeyframe = false;
+    _nextPacket = _NO_PACKET;
+    _codedMask = 0;
+    hop_reset();
+  }
+
+  return valid;
+}
+
+void DeviceProtocol::send_reply(const void* data, uint8_t size) {
+  //The remote sends again if it wasn't listening in time
+  _radio->stopListening();
+  _radio->write(data, size);
+  _radio->startListening();
+
+  //Stopping the radio cleared the ack payloads
+  _ackPending = 0;
+}
+
+void DeviceProtocol::read_settings(uint8_t* packet) {
+  if(packet[1] == _SETTINGS_TEST) {
+    //Tell the remote which settings are in use, since the change may have
+    //been turned down
+    uint8_t reply[2] = {_ACK, checksum(_settings.getSettings(), 32)};
+    send_reply(reply, 2);
+    return;
+  }
+
+  if(packet[1] != _SETTINGS_COMMIT) {
+    //A piece of the new settings
+    if(packet[1] < 32) {
+      uint8_t size = min(_settings.getPayloadSize() - 2, 32 - packet[1]);
+      memcpy(_newSettings + packet[1], packet + 2, size);
+    }
+    return;
+  }
+
+  //Only switch once every piece has arrived
+  if(packet[2] != checksum(_newSettings, 32)) {
+    return;
+  }
+
+  //Peers are paired with the current settings, and can't follow a change
+  for(uint8_t i = 0; i < _MAX_PEERS; i++) {
+    if(_peers[i].attached) {
+      return;
+    }
+  }
+
+  //Keep the settings that last worked to go back to
+  if(!_settingsTrial) {
+    memcpy(_oldSettings, _settings.getSettings(), 32);
+  }
+
+  switch_settings(_newSettings);
+  _settingsTrial = true;
+  _settingsTimer = millis();
+}
+
+void DeviceProtocol::switch_settings(const uint8_t* settings) {
+  _settings.setSettings(settings);
+
+  //The remote has already been acknowledged, so change right away
+  _radio->stopListening();
+  apply_settings(&_settings);
+  _radio->setPALevel(RF24_PA_HIGH);
+  _radio->flush_tx();
+  _radio->startListening();
+
+  //Frames in the new format start from scratch
+  _adapted = false;
+  _hasKeyframe = false;
+  _hasArrival = false;
+  _framesKept = min(_framesKept, 1);
+  _nextPacket = _NO_PACKET;
+  _codedMask = 0;
+  _ackSize = 0;
+  _ackPending = 0;
+  hop_reset();
+}
+
+void DeviceProtocol::hop_reset() {
+  build_hop_sequence(_remoteId, _deviceId);
+  //The remote counts frames from 0 again
+  _hasSequence = false;
+  _hopSynced = false;
+  _hopChannel = hop_channel(0);
+
+  if(_settings.getHopInterval() > 0) {
+    _radio->stopListening();
+    _radio->setChannel(_hopChannel);
+    _radio->startListening();
+  }
+}
+
+void DeviceProtocol::hop() {
+  if(_settings.getHopInterval() == 0) {
+    return;
+  }
+
+  uint8_t frame = 0;
+
+  if(_hopSynced) {
+    uint32_t period = 1000000 / _settings.getCommsFrequency();
+    //Frames since the last one received, rounded so that the channel changes
+    //half way between frames.
+    uint32_t frames = (micros() - _hopTime + period / 2) / period;
+
+    //After two times through the sequence without a frame, the remote could
+    //be anywhere, so wait for it on the first channel.
+    if(frames >= 2 * frame_cycle()) {
+      _hopSynced = false;
+    } else {
+      frame = (_hopFrame + frames) % frame_cycle();
+    }
+  }
+
+  uint8_t channel = hop_channel(frame);
+  if(channel == _hopChannel) {
+    return;
+  }
+  _hopChannel = channel;
+
+  _radio->stopListening();
+  _radio->setChannel(channel);
+  _radio->startListening();
+
+  reload_telemetry();
+}
+
+void DeviceProtocol::hop_sync(uint8_t frame, uint32_t time) {
+  if(frame < frame_cycle()) {
+    _hopFrame = frame;
+    _hopTime = time;
+    _hopSynced = true;
+  }
+}
+
+void DeviceProtocol::record_arrival(uint32_t now) {
+  if(_hasArrival) {
+    uint32_t period = 1000000 / _settings.getCommsFrequency();
+    uint32_t time = now - _lastArrival;
+    //Round to the nearest number of periods
+    uint32_t periods = max((time + period / 2) / period, 1);
+
+    //Every period without a frame is a lost frame.  The loss average is
+    //already 100% after 64 lost frames, so the rest are only counted.
+    for(uint32_t i = 1; i < periods; i++) {
+      if(i <= 64) {
+        record_frame(true);
+      } else {
+        _stats.framesLost += periods - i;
+        break;
+      }
+    }
+
+    uint32_t expected = periods * period;
+    record_jitter(time > expected ? time - expected : expected - time);
+  }
+
+  _stats.frames++;
+  record_frame(false);
+
+  _lastArrival = now;
+  _hasArrival = true;
+}
+
+bool DeviceProtocol::frame_is_new(uint8_t frame, uint32_t time) {
+  if(!_hasSequence) {
+    return true;
+  }
+
+  uint16_t cycle = frame_cycle();
+  uint32_t period = 1000000 / _settings.getCommsFrequency();
+
+  //After half a cycle without a frame, the frame numbers may have wrapped
+  //around, so they can't be compared.
+  if(time - _sequenceTime >= cycle / 2 * period) {
+    return true;
+  }
+
+  uint16_t ahead = (frame + cycle - _lastSequence) % cycle;
+  return ahead > 0 && ahead <= cycle / 2;
+}
+
+bool DeviceProtocol::superseded(uint8_t* packet, uint8_t* next) {
+  //Only whole frames can be skipped, as the frames after a delta, or a
+  //packet of a bigger frame, depend on it.
+  if(packets_per_frame(&_settings) != 1 ||
+     (next[0] & 0xF0) != _PACKET_CHANNELS) {
+    return false;
+  }
+
+  uint16_t cycle = frame_cycle();
+  uint16_t ahead = (next[1] + cycle - packet[1]) % cycle;
+  return ahead > 0 && ahead <= cycle / 2;
+}
+
+void DeviceProtocol::sequence_frame(uint8_t frame, uint32_t time) {
+  uint16_t cycle = frame_cycle();
+  uint32_t period = 1000000 / _settings.getCommsFrequency();
+
+  if(!_hasSequence) {
+    _framesMissed = 0;
+  } else if(time - _sequenceTime < cycle / 2 * period) {
+    _framesMissed = (frame + cycle - _lastSequence) % cycle - 1;
+  } else {
+    //The frame numbers wrapped around, so count the periods instead
+    _framesMissed = min((time - _sequenceTime + period / 2) / period - 1,
+                        255UL);
+  }
+
+  _lastSequence = frame;
+  _sequenceTime = time;
+  _hasSequence = true;
+}
+
+void DeviceProtocol::deliver_frame(uint16_t channels[], uint8_t* packet,
+                                   uint32_t time) {
+  record_arrival(time);
+  sequence_frame(packet[1], time);
+  keep_frame(channels, time);
+  interpolate_to(channels, time);
+
+  //The remote sends 0 until its link clock is synced
+  if(_settings.getEnableTimestamps()) {
+    uint32_t sent = read_time(packet + 2);
+    if(sent != 0) {
+      //A clock that is slightly off can make the frame look early
+      int32_t latency = time - sent;
+      _frameLatency = max(latency, 0);
+      record_latency(_frameLatency);
+    }
+  }
+}
+
+uint8_t DeviceProtocol::getFrameNumber() {
+  return _lastSequence;
+}
+
+uint8_t DeviceProtocol::getFramesMissed() {
+  return _framesMissed;
+}
+
+uint32_t DeviceProtocol::getFrameLatency() {
+  return _frameLatency;
+}
+
+uint32_t DeviceProtocol::getLatencyPercentile(uint8_t percent) {
+  return latency_percentile(percent);
+}
+
+uint32_t DeviceProtocol::getLinkTime() {
+  return micros();
+}
+
+void DeviceProtocol::keep_frame(uint16_t channels[], uint32_t time) {
+  if(_failsafe == NULL) {
+    return;
+  }
+
+  uint8_t numChannels = min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+
+  if(_framesKept > 0) {
+    uint32_t period = 1000000 / _settings.getCommsFrequency();
+    //Round to the nearest number of periods, so the slope is per frame
+    _frameGap = constrain((time - _lastFrameTime + period / 2) / period, 1, 255);
+    memcpy(_prevFrame, _lastFrame, numChannels * sizeof(uint16_t));
+  }
+
+  memcpy(_lastFrame, channels, numChannels * sizeof(uint16_t));
+  _lastFrameTime = time;
+  _framesKept = min(_framesKept + 1, 2);
+  _channelState = RC_CHANNELS_LIVE;
+}
+
+void DeviceProtocol::restore_frame(uint16_t channels[]) {
+  if(_channelState == RC_CHANNELS_LIVE) {
+    return;
+  }
+
+  uint8_t numChannels = min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+  memcpy(channels, _lastFrame, numChannels * sizeof(uint16_t));
+}
+
+bool DeviceProtocol::apply_failsafe(uint16_t channels[]) {
+  //Once at the failsafe values, there is nothing left to change
+  if(_failsafe == NULL || _framesKept == 0 ||
+     _channelState == RC_CHANNELS_FAILSAFE) {
+    return false;
+  }
+
+  uint32_t period = 1000000 / _settings.getCommsFrequency();
+  uint32_t age = micros() - _lastFrameTime;
+  //A frame is only missed once it is half a period late, so jitter doesn't
+  //set off the failsafe
+  uint32_t missed = (age + period / 2) / period;
+
+  if(missed <= 1) {
+    return false;
+  }
+  missed--;
+
+  //progress through the ramp (millis)
+  uint32_t ramp = 0;
+
+  if(age >= (RC_FAILSAFE_TIMEOUT + RC_FAILSAFE_RAMP) * 1000UL) {
+    _channelState = RC_CHANNELS_FAILSAFE;
+  } else if(age >= RC_FAILSAFE_TIMEOUT * 1000UL) {
+    _channelState = RC_CHANNELS_RAMPING;
+    ramp = age / 1000 - RC_FAILSAFE_TIMEOUT;
+  } else if(missed <= RC_FAILSAFE_PREDICT && _framesKept > 1) {
+    _channelState = RC_CHANNELS_PREDICTED;
+  } else {
+    _channelState = RC_CHANNELS_HELD;
+  }
+
+  //Predictions stop after RC_FAILSAFE_PREDICT frames, and are held after
+  uint32_t steps = min(missed, (uint32_t)RC_FAILSAFE_PREDICT);
+  int32_t maxValue = (1UL << _settings.getChannelResolution()) - 1;
+  uint8_t numChannels = min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+  bool changed = false;
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    int32_t value = _lastFrame[i];
+
+    if(_framesKept > 1) {
+      value += ((int32_t)_lastFrame[i] - _prevFrame[i]) * (int32_t)steps /
+               _frameGap;
+      value = constrain(value, 0, maxValue);
+    }
+
+    if(_failsafe[i] != RC_FAILSAFE_HOLD) {
+      if(_channelState == RC_CHANNELS_FAILSAFE) {
+        value = _failsafe[i];
+      } else if(_channelState == RC_CHANNELS_RAMPING) {
+        value += ((int32_t)_failsafe[i] - value) * (int32_t)ramp /
+                 RC_FAILSAFE_RAMP;
+      }
+    }
+
+    if(channels[i] != value) {
+      channels[i] = value;
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+void DeviceProtocol::setFailsafe(const uint16_t values[]) {
+  _failsafe = values;
+  _framesKept = 0;
+  _channelState = RC_CHANNELS_LIVE;
+}
+
+uint8_t DeviceProtocol::getChannelState() {
+  return _channelState;
+}
+
+uint16_t DeviceProtocol::interpolated(uint8_t channel, uint32_t time) {
+  uint32_t elapsed = time - _interpStart;
+
+  //Frames timed by an interrupt can arrive after the output was read
+  if((int32_t)elapsed < 0) {
+    elapsed = 0;
+  }
+  if(elapsed >= _interpLatency) {
+    return _interpTo[channel];
+  }
+
+  //progress towards the new channels, in 1/1024ths
+  int32_t progress = elapsed * 1024 / _interpLatency;
+  int32_t from = _interpFrom[channel];
+
+  return from + ((int32_t)_interpTo[channel] - from) * progress / 1024;
+}
+
+void DeviceProtocol::interpolate_to(uint16_t channels[], uint32_t time) {
+  if(_interpLatency == 0) {
+    return;
+  }
+
+  uint8_t numChannels = min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    //The first frame has nothing to move from
+    _interpFrom[i] = _interpReady ? interpolated(i, time) : channels[i];
+    _interpTo[i] = channels[i];
+  }
+
+  _interpStart = time;
+  _interpReady = true;
+}
+
+void DeviceProtocol::setInterpolation(uint32_t latency) {
+  _interpLatency = min(latency, 1000000UL);
+  _interpReady = false;
+}
+
+bool DeviceProtocol::interpolate(uint16_t output[]) {
+  if(_interpLatency == 0 || !_interpReady) {
+    return false;
+  }
+
+  uint8_t numChannels = min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+  uint32_t now = micros();
+  bool changed = false;
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    uint16_t value = interpolated(i, now);
+
+    if(output[i] != value) {
+      output[i] = value;
+      changed = true;
+    }
+  }
+
+  return changed;
+}
+
+int8_t DeviceProtocol::update(uint16_t channels[], uint8_t telemetry[],
+                              DeviceProtocol::setConnected setConnected) {
+  return update(channels, telemetry, _settings.getPayloadSize(), setConnected);
 }
 
 int8_t DeviceProtocol::update(uint16_t channels[], uint8_t telemetry[],
+                              uint8_t telemetrySize,
                               DeviceProtocol::setConnected setConnected) {
   if(!isConnected()) {
+    //A link that was dropped still needs to fail safe
+    if(apply_failsafe(channels)) {
+      interpolate_to(channels, micros());
+    }
     return RC_ERROR_NOT_CONNECTED;
   }
 
-  uint8_t packet[_settings.getPayloadSize()];
+  //Two packets are held, so the one after the current packet can be looked
+  //at.  They are full size, since new settings can change the payload size.
+  uint8_t packets[2][32];
+  uint8_t* packet = packets[0];
+  uint8_t* next = packets[1];
 
   int8_t packetStatus = 0;
+  int8_t nextStatus = 0;
   int8_t status = 0;
 
-  //Load a transmission, and send an ack payload.
+  telemetrySize = min(telemetrySize, _settings.getPayloadSize());
+
+  hop();
+
+  uint8_t pipe = 0;
+  uint32_t time = 0;
+  uint8_t nextPipe = 0;
+  uint32_t nextTime = 0;
+
+  //Load a transmission.
   packetStatus = check_packet(packet,
                               _settings.getPayloadSize() * sizeof(uint8_t),
-                              telemetry, _settings.getPayloadSize());
+                              &pipe, &time);
 
 
   //read through each transmission we have gotten since the last update
   while(packetStatus == 1) {
 
-    //Covert packet to channels
+    //The packet took the ack payload loaded for its pipe
+    ack_delivered(pipe);
 
-    //Check if the packet is a channel packet
-    if((packet[0] & 0xF0) == _PACKET_CHANNELS) {
+    //Load the next transmission, so a frame that is already out of date
+    //isn't decoded.
+    nextStatus = check_packet(next,
+                              _settings.getPayloadSize() * sizeof(uint8_t),
+                              &nextPipe, &nextTime);
 
-      status = 1;
+    //Packets from peers don't affect the main remote's link
+    if(pipe != 1) {
+      if(pipe >= _PEER_PIPE && pipe < _PEER_PIPE + _MAX_PEERS) {
+        read_peer(pipe, packet);
+      }
 
-      for(uint8_t i = 0; i < _settings.getNumChannels(); i++) {
-        channels[i] = ((packet[i * 2 + 1] << 8)) | (packet[i * 2 + 2]);
+      //Check if the packet is a channel packet
+    } else if((packet[0] & 0xF0) == _PACKET_CHANNELS) {
+      //A duplicate or late frame would also put the hop timing out
+      if(!frame_is_new(packet[1], time)) {
+        //The parity packet isn't needed once its frame is complete
+        uint8_t index = packet[0] & _PACKET_CHANNELS_INDEX;
+        if(!parity_packet(&_settings) ||
+           index != packets_per_frame(&_settings)) {
+          _stats.framesStale++;
+        }
+      } else {
+        hop_sync(packet[1], time);
+
+        if(nextStatus == 1 && nextPipe == 1 && superseded(packet, next)) {
+          //Only the newer frame needs decoding, but this one still arrived
+          _stats.framesSkipped++;
+          record_arrival(time);
+          sequence_frame(packet[1], time);
+        } else if(read_channels(packet, channels)) {
+          deliver_frame(channels, packet, time);
+          status = 1;
+        }
+      }
+      _adaptTimer = millis();
+      _settingsTrial = false;
+
+      //If the packet is a delta of the changed channels
+    } else if((packet[0] & ~_PACKET_CHANNELS_TOGGLE) == _PACKET_CHANNELS_DELTA) {
+      if(!frame_is_new(packet[1], time)) {
+        _stats.framesStale++;
+      } else {
+        hop_sync(packet[1], time);
+
+        //A delta means nothing without the frame it is based on.  Without
+        //acks, that keyframe may have been lost.
+        if(_hasKeyframe && (!error_correction(&_settings) ||
+           (packet[0] & _PACKET_CHANNELS_TOGGLE) == _keyframeToggle)) {
+          restore_frame(channels);
+          read_delta(packet, channels);
+          deliver_frame(channels, packet, time);
+          status = 1;
+        }
+      }
+      _adaptTimer = millis();
+      _settingsTrial = false;
+
+      //If the packet has only the primary channels
+    } else if(packet[0] == _PACKET_CHANNELS_PRIMARY) {
+      if(!frame_is_new(packet[1], time)) {
+        _stats.framesStale++;
+      } else {
+        hop_sync(packet[1], time);
+
+        //The aux channels are kept from the last frame that had them
+        if(_hasKeyframe) {
+          restore_frame(channels);
+          read_primary(packet, channels);
+          deliver_frame(channels, packet, time);
+          status = 1;
+        }
+      }
+      _adaptTimer = millis();
+      _settingsTrial = false;
+
+      //If the packet changes the radio settings
+    } else if(packet[0] == _PACKET_UPDATE_TRANS_SETTINGS) {
+      //The remote has already been acknowledged, so change right away
+      if(packet[1] <= RF24_250KBPS && packet[2] <= RF24_PA_MAX) {
+        set_link((rf24_datarate_e)packet[1], packet[2]);
       }
 
+      //If the packet changes the settings of the link
+    } else if(packet[0] == _PACKET_UPDATE_RECVR_SETTINGS) {
+      read_settings(packet);
+
       //If the packet is a Disconnect Packet
     } else if(packet[0] == _PACKET_DISCONNECT) {
       if(!_settings.getEnableAck()) {
-        _radio->stopListening();
-        delay(50);
-        _radio->write(const_cast<uint8_t*>(&_ACK), 1);
-        _radio->startListening();
+        send_reply(&_ACK, 1);
       }
 
       _isConnected = false;
       setConnected(false);
 
+      //If the remote didn't hear the reply to its connection test
+    } else if(packet[0] == _TEST) {
+      if(!_settings.getEnableAck()) {
+        send_reply(&_TEST, 1);
+      }
+
       //If the packet is a Reconnect Packet
     } else if(packet[0] == _PACKET_RECONNECT) {
-      if(!_settings.getEnableAck()) {
-        _radio->stopListening();
-        delay(20);
-        _radio->write(const_cast<uint8_t*>(&_ACK), 1);
-        _radio->startListening();
+      //The remote has different settings, so a full handshake is needed
+      if(!read_resume(packet)) {
+        _isConnected = false;
+        setConnected(false);
       }
     }
 
-    //Load a transmission.
-    packetStatus = check_packet(packet,
-                                _settings.getPayloadSize() * sizeof(uint8_t));
+    //Move on to the next transmission, unless the link was dropped
+    uint8_t* read = packet;
+    packet = next;
+    next = read;
+    pipe = nextPipe;
+    time = nextTime;
+    packetStatus = isConnected() ? nextStatus : RC_ERROR_NOT_CONNECTED;
   }
 
   if(packetStatus < 0) {
     status = packetStatus;
   }
 
+  //Without a new frame, the failsafe looks after the channels
+  if(status == 0 && apply_failsafe(channels)) {
+    interpolate_to(channels, micros());
+    status = 1;
+  }
+
+  //Keep the freshest telemetry waiting for the next packet, so it goes back
+  //with it instead of the one after.
+  if(isConnected()) {
+    load_telemetry(telemetry, telemetrySize);
+  }
+
+  //If the remote can't be heard after a change, fall back to the connection
+  //settings, which is what the remote will also do.
+  if(_adapted && millis() - _adaptTimer >= RC_ADAPT_TIMEOUT) {
+    set_link(_settings.getDataRate(), RF24_PA_HIGH);
+  }
+
+  //The same goes for new settings that haven't been used for a frame yet
+  if(_settingsTrial && millis() - _settingsTimer >= RC_ADAPT_TIMEOUT) {
+    switch_settings(_oldSettings);
+    _settingsTrial = false;
+  }
+
   return status;
 }
 
+RCStats* DeviceProtocol::getStats() {
+  return &_stats;
+}
+
+void DeviceProtocol::resetStats() {
+  reset_stats();
+}
+
 RCSettings* DeviceProtocol::getSettings() {
   return &_settings;
 }
\ No newline at end of file
@@ -18,9 +18,69 @@
 //Userdefined Constants
 //Global constants can be found in rcGlobal.h
 
+/**
+ * Number of packets that can wait between handleInterrupt() and update()
+ */
+#ifndef RC_RX_BUFFER
+#define RC_RX_BUFFER 4
+#endif
+
+/**
+ * Number of missed frames the failsafe predicts the channels for, from the
+ * last two frames, before holding them.  See DeviceProtocol::setFailsafe()
+ */
+#ifndef RC_FAILSAFE_PREDICT
+#define RC_FAILSAFE_PREDICT 3
+#endif
+
+/**
+ * How long (millis) without a frame before the failsafe ramps the channels
+ * to their failsafe values
+ */
+#ifndef RC_FAILSAFE_TIMEOUT
+#define RC_FAILSAFE_TIMEOUT 500
+#endif
+
+/**
+ * How long (millis) the failsafe takes to ramp the channels to their
+ * failsafe values
+ */
+#ifndef RC_FAILSAFE_RAMP
+#define RC_FAILSAFE_RAMP 1000
+#endif
+
 //Error Constants
 //Global constatns can be found in rcGlobal.h
 
+/**
+ * Failsafe value of a channel that keeps its last value, see
+ * DeviceProtocol::setFailsafe()
+ */
+#define RC_FAILSAFE_HOLD 0xFFFF
+
+//Channel States, see DeviceProtocol::getChannelState()
+
+/**
+ * The channels are from the latest frame
+ */
+#define RC_CHANNELS_LIVE 0
+/**
+ * Frames were missed, so the channels are predicted from the last frames
+ */
+#define RC_CHANNELS_PREDICTED 1
+/**
+ * The channels are held at the last prediction
+ */
+#define RC_CHANNELS_HELD 2
+/**
+ * The channels are ramping to their failsafe values
+ */
+#define RC_CHANNELS_RAMPING 3
+/**
+ * The channels are at their failsafe values
+ */
+#define RC_CHANNELS_FAILSAFE 4
+
 /**
  * Communication Protocol for receivers
  */
@@ -78,7 +138,9 @@ public:
    * Begin the Protocol
    *
    * If the system power cycled or reset while in use, it will try to reconnect
-   * immidiately.
+   * immidiately.  If the remote was reset as well, it resumes the connection
+   * with a challenge from RemoteProtocol::begin().  A remote with different
+   * settings is disconnected, so a full connect() is needed.
    *
    * @note There is no need to begin the RF24 driver, as this function already
    * does this for you
@@ -100,13 +162,29 @@ public:
    * @note The transmitter you are trying to pair with should also be in pair mode
    *
    * @param saveRemoteID A function pointer to save the id of the transmitter.
+   * @param pipe 1 to pair the main remote, or 2 to 5 to pair a peer, see
+   * attachPeer()
    *
    * @return 0 if successful
    * @return #RC_ERROR_ALREADY_CONNECTED if already connected to remote
    * @return #RC_ERROR_TIMEOUT if no transmitter was found.
    * @return #RC_ERROR_LOST_CONNECTION if transmitter stopped replying
    */
-  int8_t pair(saveRemoteID saveRemoteID);
+  int8_t pair(saveRemoteID saveRemoteID, uint8_t pipe = 1);
+
+  /**
+   * Start pairing with a transmitter without waiting for it to finish
+   *
+   * This does the same as pair(), but returns straight away.  Call
+   * pollHandshake() until it no longer returns #RC_INFO_HANDSHAKE_PENDING.
+   *
+   * @param saveRemoteID A function pointer to save the id of the transmitter.
+   * @param pipe 1 to pair the main remote, or 2 to 5 to pair a peer
+   *
+   * @return #RC_INFO_HANDSHAKE_PENDING if pairing has started
+   * @return #RC_ERROR_ALREADY_CONNECTED if already connected to remote
+   */
+  int8_t beginPair(saveRemoteID saveRemoteID, uint8_t pipe = 1);
 
   /**
    * Check if the receiver is connected with a transmitter.
@@ -134,23 +212,323 @@ public:
    */
   int8_t connect(loadRemoteID loadRemoteID, setConnected setConnected);
 
+  /**
+   * Start connecting with a transmitter without waiting for it to finish
+   *
+   * This does the same as connect(), but returns straight away.  Call
+   * pollHandshake() until it no longer returns #RC_INFO_HANDSHAKE_PENDING.
+   *
+   * @param loadRemoteID loadRemoteID()
+   * @param setConnected setConnected()
+   *
+   * @return #RC_INFO_HANDSHAKE_PENDING if connecting has started
+   * @return #RC_ERROR_ALREADY_CONNECTED if already connected to remote
+   */
+  int8_t beginConnect(loadRemoteID loadRemoteID, setConnected setConnected);
+
+  /**
+   * Continue the handshake started by beginPair() or beginConnect()
+   *
+   * Each call only does as much as it can without waiting, so it can be
+   * called from the main loop while other work carries on.
+   *
+   * @return #RC_INFO_HANDSHAKE_PENDING if the handshake is still running
+   * @return 0 if the handshake was successful, or if already connected
+   * @return #RC_ERROR_NOT_CONNECTED if no handshake is running
+   * @return any error returned by pair() or connect()
+   */
+  int8_t pollHandshake();
+
   /**
    * Update the communications with the currently connected device
    *
    * If there was a packet sent, it will process it.
    *
+   * The telemetry is left waiting in the radio for the remote's next packet,
+   * and is replaced whenever it changes, so the remote gets the telemetry
+   * from the latest call.
+   *
    * @param channels RCSettings.setNumChannels() size array that is set
-   * when a standard packet is received.
+   * when a standard packet is received.  When a frame is split into several
+   * packets, channels is only set once the whole frame has been received.
+   * Delta frames only set the channels that changed, so channels should be
+   * the same array every call.
    * @param telemetry RCSettings.setPayloadSize() size array of telemetry
    * data to send to the transmitter
    * @param setConnected setConnected()
    *
+   * With setFailsafe(), the channels are also changed while frames are
+   * missing, even once disconnected.
+   *
    * @return 1 if channels were updated
    * @return 0 if nothing happened
    * @return #RC_ERROR_NOT_CONNECTED if not connected
    */
   int8_t update(uint16_t channels[], uint8_t telemetry[],
                 setConnected setConnected);
+  /**
+   * Update the communications with the currently connected device
+   *
+   * The same as update(), but only telemetrySize bytes of telemetry are
+   * sent.  With dynamic payloads this makes the acknowledgements shorter.
+   *
+   * @param channels RCSettings.setNumChannels() size array that is set
+   * when a standard packet is received.
+   * @param telemetry telemetrySize array of telemetry data to send to the
+   * transmitter
+   * @param telemetrySize size of telemetry in bytes, no more than
+   * RCSettings.setPayloadSize()
+   * @param setConnected setConnected()
+   *
+   * @return 1 if channels were updated
+   * @return 0 if nothing happened
+   * @return #RC_ERROR_NOT_CONNECTED if not connected
+   */
+  int8_t update(uint16_t channels[], uint8_t telemetry[], uint8_t telemetrySize,
+                setConnected setConnected);
+
+  /**
+   * Keep the channels moving safely when frames stop arriving
+   *
+   * While frames are missed, update() changes the channels instead of
+   * leaving them where the last frame put them:
+   *  - for #RC_FAILSAFE_PREDICT frames, the channels carry on in the
+   *    direction of the last two frames
+   *  - they are then held until #RC_FAILSAFE_TIMEOUT has passed since the
+   *    last frame
+   *  - over the next #RC_FAILSAFE_RAMP, they ramp to their failsafe values
+   *
+   * The next frame puts the channels back to what the remote sends.  Use
+   * getChannelState() to see which of these the channels are in.  Peers
+   * don't use the failsafe.
+   *
+   * The values aren't copied, so values must stay valid while the failsafe
+   * is used.
+   *
+   * @param values RCSettings.setNumChannels() size array of failsafe values,
+   * #RC_FAILSAFE_HOLD for a channel that stays at its last value, or NULL to
+   * turn off the failsafe
+   */
+  void setFailsafe(const uint16_t values[]);
+  /**
+   * Get where the channels set by update() came from
+   *
+   * @return #RC_CHANNELS_LIVE if they are from the latest frame
+   * @return #RC_CHANNELS_PREDICTED, #RC_CHANNELS_HELD, #RC_CHANNELS_RAMPING
+   * or #RC_CHANNELS_FAILSAFE if frames are missing, see setFailsafe()
+   */
+  uint8_t getChannelState();
+
+  /**
+   * Get the frame number of the channels last set by update()
+   *
+   * The remote numbers every slot, counting up to 255, or to the end of the
+   * hop cycle when hopping, before starting again from 0.  Frames that are
+   * duplicates of, or older than, a frame already received are dropped, see
+   * RCStats::framesStale.
+   *
+   * @return frame number
+   */
+  uint8_t getFrameNumber();
+  /**
+   * Get the number of frames lost right before the channels last set by
+   * update()
+   *
+   * @return frames missing between the last two frames received, up to 255
+   */
+  uint8_t getFramesMissed();
+
+  /**
+   * Get how long the last frame took to arrive
+   *
+   * This is the time from the remote sending the frame to update() reading
+   * it, measured with the link clock.
+   *
+   * Note: needs RCSettings.setEnableTimestamps() and
+   * RCSettings.setEnableAckPayload(), see RemoteProtocol::getLinkTime()
+   *
+   * @return latency in micros, or 0 if the clocks haven't been synced
+   */
+  uint32_t getFrameLatency();
+  /**
+   * Get a percentile of the frame latencies, from RCStats.latency
+   *
+   * @param percent 0-100, 50 for the median
+   *
+   * @return upper limit of the histogram bucket the percentile falls in
+   * (micros), or 0 if none have been measured
+   */
+  uint32_t getLatencyPercentile(uint8_t percent);
+  /**
+   * Get the time of the link clock
+   *
+   * The link clock is the device's micros(), which the remote follows with
+   * RemoteProtocol::getLinkTime().
+   *
+   * @return link time in micros
+   */
+  uint32_t getLinkTime();
+
+  /**
+   * Smooth the channels for outputs that update faster than frames arrive
+   *
+   * Servos and ESCs can take new values far more often than the comms
+   * frequency.  Instead of stepping once a frame, interpolate() moves from
+   * where it was towards each new frame, reaching it latency after the frame
+   * arrived.  Frames are timed by when they arrived, so jitter in the main
+   * loop doesn't show in the output.
+   *
+   * With a latency of one period of RCSettings.setCommsFrequency(), the
+   * output follows a straight line between frames.  A shorter latency adds
+   * less delay, but holds at each frame until the next arrives.
+   *
+   * @param latency time (micros) to reach each new frame, up to 1 second,
+   * or 0 to turn off interpolation
+   */
+  void setInterpolation(uint32_t latency);
+  /**
+   * Get the channels for an output at this moment
+   *
+   * Call as often as the output can take new values.  The channels follow
+   * what update() sets, including the failsafe, see setInterpolation().
+   *
+   * @param output RCSettings.setNumChannels() size array to set
+   *
+   * @return true if the output changed
+   * @return false if nothing changed, or interpolation is off
+   */
+  bool interpolate(uint16_t output[]);
+
+  /**
+   * Receive packets from the radio's IRQ pin instead of polling
+   *
+   * When enabled, the radio only interrupts when a packet is received, and
+   * handleInterrupt() reads every waiting packet into a buffer of
+   * #RC_RX_BUFFER packets, along with the time it arrived.  update() then
+   * reads from the buffer instead of asking the radio over SPI.
+   *
+   * Call handleInterrupt() from an interrupt on the falling edge of the IRQ
+   * pin.  Since the interrupt uses SPI, tell the SPI library about it so it
+   * is held off while update() uses the radio:
+   * @code
+   * void radioInterrupt() {
+   *   device.handleInterrupt();
+   * }
+   *
+   * SPI.usingInterrupt(digitalPinToInterrupt(IRQ_PIN));
+   * attachInterrupt(digitalPinToInterrupt(IRQ_PIN), radioInterrupt, FALLING);
+   * device.setInterruptMode(true);
+   * @endcode
+   *
+   * @param enable true to receive from interrupts
+   */
+  void setInterruptMode(bool enable);
+  /**
+   * Read received packets from the radio, called from the IRQ pin's
+   * interrupt.  See setInterruptMode()
+   *
+   * Does nothing unless connected, so handshakes can use the radio.
+   */
+  void handleInterrupt();
+
+  /**
+   * Listen for a peer on one of the radio's other pipes
+   *
+   * Peers are extra remotes, such as a trainer remote or a telemetry add-on,
+   * that send to the device while it is connected to its main remote.  A
+   * peer is paired with pair() on the same pipe, and then joins with
+   * RemoteProtocol::join() once the device is connected.  Packets from the
+   * peer are read by update(), and the peer's telemetry is sent back in its
+   * own acknowledgements.
+   *
+   * Peers use the device's settings, so there are some limits:
+   *  - acknowledgements must be enabled
+   *  - every channel must fit in one packet
+   *  - frequency hopping and adaptive link control can't be used
+   *  - the radio only holds 3 ack payloads, so no more than 3 links should
+   *    use ack payloads
+   *
+   * @param pipe pipe of the peer (2 to 5)
+   * @param channels RCSettings.setNumChannels() size array to set when the
+   * peer sends channels
+   * @param telemetry telemetrySize array to send back to the peer, or NULL
+   * @param telemetrySize size of telemetry in bytes
+   *
+   * @return 0 if successful
+   * @return -1 if the pipe is not 2 to 5, or the settings can't be used
+   * with peers
+   */
+  int8_t attachPeer(uint8_t pipe, uint16_t channels[], uint8_t telemetry[],
+                    uint8_t telemetrySize);
+  /**
+   * Stop listening for a peer
+   *
+   * @param pipe pipe of the peer (2 to 5)
+   */
+  void detachPeer(uint8_t pipe);
+  /**
+   * Check if a peer has sent to the device since it last disconnected
+   *
+   * @param pipe pipe of the peer (2 to 5)
+   *
+   * @return true if the peer is connected
+   */
+  bool isPeerConnected(uint8_t pipe);
+  /**
+   * Check if the channels of a peer were set since the last call
+   *
+   * @param pipe pipe of the peer (2 to 5)
+   *
+   * @return true if the peer's channels were updated
+   */
+  bool pollPeer(uint8_t pipe);
+
+  /**
+   * Send a message to the remote over the telemetry stream
+   *
+   * The stream is for data that doesn't fit in one ack payload, such as
+   * logs or configuration.  The message is split into fragments which are
+   * sent in the ack payloads, taking turns with the telemetry given to
+   * update(), and read in order by RemoteProtocol::readStream() as they
+   * arrive, so the message can be longer than the remote's buffer.
+   *
+   * The message isn't copied, so data must not change until
+   * getStreamRemaining() returns 0.  A fragment is counted as sent once the
+   * remote sends its next packet.
+   *
+   * Note: the stream needs RCSettings.setEnableStream(),
+   * RCSettings.setEnableAck() and RCSettings.setEnableAckPayload()
+   *
+   * @param data message to send
+   * @param size size of the message in bytes
+   *
+   * @return true if the message will be sent
+   * @return false if the stream can't be used, or the last message is still
+   * being sent
+   */
+  bool writeStream(const uint8_t data[], uint16_t size);
+  /**
+   * Get the number of bytes of the current stream message that haven't
+   * been sent yet
+   *
+   * @return bytes left to send, 0 once writeStream() can be called again
+   */
+  uint16_t getStreamRemaining();
+
+  /**
+   * Get the statistics of the link
+   *
+   * The statistics are updated by update(), so reading them doesn't touch
+   * the radio.  Lost frames are found from gaps between frames, so they are
+   * only counted once the next frame arrives.
+   *
+   * @return statistics
+   */
+  RCStats* getStats();
+  /**
+   * Clear the statistics of the link
+   */
+  void resetStats();
 
   /**
    * Get pointer for the current settings
@@ -160,27 +538,465 @@ public:
   RCSettings* getSettings();
 private:
 
+  const uint8_t _NO_PACKET = 0xFF;
+
+  //States of the pair and connect handshakes
+  enum {
+    _HANDSHAKE_IDLE = 0,
+    _PAIR_WAIT_ID,
+    _PAIR_SEND_ID,
+    _PAIR_SEND_SETTINGS,
+    _CONNECT_SEND_ID,
+    _CONNECT_WAIT_REPLY,
+    _CONNECT_WAIT_TEST,
+    _CONNECT_SEND_TEST
+  };
+
+  //The first pipe that can be used by a peer, and the number of peers
+  static const uint8_t _PEER_PIPE = 2;
+  static const uint8_t _MAX_PEERS = 4;
+
+  //A remote sending on one of pipes 2 to 5
+  struct Peer {
+    uint16_t* channels;
+    uint8_t* telemetry;
+    uint8_t telemetrySize;
+    bool attached;
+    bool connected;
+    bool updated;
+    bool hasKeyframe;
+  };
+
+  //A packet read by handleInterrupt()
+  struct RxPacket {
+    uint8_t data[32];
+    uint8_t size;
+    uint8_t pipe;
+    uint32_t time;
+  };
+
   const uint8_t* _deviceId;
   uint8_t _remoteId[5];
   bool _isConnected;
 
+  //interrupt variables.  _rxHead is only changed by the interrupt, and
+  //_rxTail only by update(), so the buffer needs no locking.
+  bool _interruptMode;
+  RxPacket _rxBuffer[RC_RX_BUFFER];
+  volatile uint8_t _rxHead;
+  volatile uint8_t _rxTail;
+  //packets were left in the radio since the buffer was full
+  volatile bool _rxPending;
+
+  //pipe the current pairing is for
+  uint8_t _pairPipe;
+
+  Peer _peers[_MAX_PEERS];
+
+  //handshake variables
+  saveRemoteID* _saveRemoteID;
+  setConnected* _setConnected;
+
+  //multi-packet frame variables
+  uint16_t _frame[RC_MAX_CHANNELS];
+  uint8_t _nextPacket;
+  uint8_t _frameToggle;
+  bool _hasKeyframe;
+  //toggle of the last keyframe delivered
+  uint8_t _keyframeToggle;
+  //error corrected frame variables.  The mask has a bit for each packet of
+  //the frame read so far, and the parity is the XOR of their channel bytes.
+  uint8_t _codedFrame;
+  uint8_t _codedMask;
+  uint8_t _parity[32];
+
+  //adaptive link control variables
+  bool _adapted;
+  uint32_t _adaptTimer;
+
+  //statistics variables
+  uint32_t _lastArrival;
+  bool _hasArrival;
+
+  //failsafe variables.  The last two frames are kept to predict the
+  //channels from.
+  const uint16_t* _failsafe;
+  uint16_t _lastFrame[RC_MAX_CHANNELS];
+  uint16_t _prevFrame[RC_MAX_CHANNELS];
+  //time the last frame was received (micros)
+  uint32_t _lastFrameTime;
+  //periods between the last two frames
+  uint8_t _frameGap;
+  //number of frames kept (0 to 2)
+  uint8_t _framesKept;
+  uint8_t _channelState;
+
+  //interpolation variables.  The output moves from _interpFrom to _interpTo
+  //starting at _interpStart.
+  uint32_t _interpLatency;
+  uint16_t _interpFrom[RC_MAX_CHANNELS];
+  uint16_t _interpTo[RC_MAX_CHANNELS];
+  uint32_t _interpStart;
+  bool _interpReady;
+
+  //frame sequence variables
+  uint8_t _lastSequence;
+  //time the last frame was received (micros)
+  uint32_t _sequenceTime;
+  bool _hasSequence;
+  uint8_t _framesMissed;
+  //time from the remote sending the last frame to reading it (micros)
+  uint32_t _frameLatency;
+
+  //frequency hopping variables
+  uint8_t _hopFrame;
+  uint32_t _hopTime;
+  bool _hopSynced;
+  uint8_t _hopChannel;
+
+  //settings change variables.  New settings are on trial until a frame is
+  //received with them.
+  uint8_t _newSettings[32];
+  uint8_t _oldSettings[32];
+  bool _settingsTrial;
+  uint32_t _settingsTimer;
+
+  //ack payload loaded on pipe 1, kept to load again when the radio clears it
+  uint8_t _ack[32];
+  uint8_t _ackSize;
+  //pipes with an ack payload waiting in the radio
+  uint8_t _ackPending;
+
+  //telemetry stream variables
+  const uint8_t* _streamData;
+  uint16_t _streamSize;
+  uint16_t _streamOffset;
+  //size of the fragment in the ack payload
+  uint8_t _streamLoaded;
+  uint8_t _streamSequence;
+  bool _streamTurn;
+
+
+  /**
+   * Run one step of the pair handshake
+   *
+   * @return see pollHandshake()
+   */
+  int8_t poll_pair();
+  /**
+   * Run one step of the connect handshake
+   *
+   * @return see pollHandshake()
+   */
+  int8_t poll_connect();
+  /**
+   * Finish a successful connect handshake
+   *
+   * @return 0
+   */
+  int8_t connect_finish();
+  /**
+   * Stop the running handshake
+   *
+   * @param status status to return
+   *
+   * @return status
+   */
+  int8_t handshake_end(int8_t status);
 
   /**
    * Check if a packet is available, and read it to returnData
    *
+   * In interrupt mode, the packet is taken from the buffer filled by
+   * handleInterrupt().
+   *
    * @param returnData data to set if data was received
    * @param dataSize size of returnData in bytes
-   * @param telemetry Data to Send back.  Note: telemetry won't be sent if
-   * ack payloads are disabled
-   * @param telemetrySize size of telemetry in bytes
+   * @param pipe set to the pipe the packet was received on
+   * @param time set to the time the packet was received (micros)
    *
    * @return 1 if data is available
    * @return 0 if nothing is available
    * @return #RC_ERROR_NOT_CONNECTED if not connected
    */
-  int8_t check_packet(void* returnData, uint8_t dataSize, void* telemetry,
-                      uint8_t telemetrySize);
-  int8_t check_packet(void* returnData, uint8_t dataSize);
+  int8_t check_packet(void* returnData, uint8_t dataSize, uint8_t* pipe,
+                      uint32_t* time);
+  /**
+   * Move packets from the radio to the interrupt buffer until either is
+   * empty or full
+   *
+   * @param time time the packets were received (micros)
+   */
+  void read_fifo(uint32_t time);
+  /**
+   * Clear the radio's interrupt, and read anything already received, so the
+   * IRQ pin can signal the next packet.
+   */
+  void restart_interrupt();
+  /**
+   * Keep an ack payload waiting in the radio for every pipe with telemetry
+   *
+   * Pipes that took their payload are loaded with the next one.  On pipe 1
+   * the next fragment of the stream may be loaded instead.  If the telemetry
+   * waiting on pipe 1 has changed since it was loaded, it is replaced, so
+   * the remote always gets the freshest telemetry.
+   *
+   * Note: telemetry won't be sent if ack payloads are disabled
+   *
+   * @param telemetry data to send back on pipe 1, or NULL
+   * @param telemetrySize size of telemetry in bytes
+   */
+  void load_telemetry(uint8_t telemetry[], uint8_t telemetrySize);
+  /**
+   * Check if a packet has been received that update() hasn't read yet
+   *
+   * @return true if a packet is waiting
+   */
+  bool packet_waiting();
+  /**
+   * Mark the ack payload of a pipe as sent, after a packet was received on
+   * it
+   *
+   * @param pipe pipe the packet was received on
+   */
+  void ack_delivered(uint8_t pipe);
+  /**
+   * Load the ack payload of pipe 1 again, after the radio has cleared it
+   */
+  void reload_telemetry();
+  /**
+   * Load the ack payload of pipe 1 into the radio
+   */
+  void write_ack();
+  /**
+   * Put telemetry in an ack payload
+   *
+   * @param ack ack payload to fill
+   * @param telemetry telemetry to send
+   * @param telemetrySize size of telemetry in bytes
+   * @param timing include when the last frame arrived, peers leave it empty
+   *
+   * @return size of the ack payload
+   */
+  uint8_t build_telemetry(uint8_t* ack, void* telemetry, uint8_t telemetrySize,
+                          bool timing = true);
+  /**
+   * Put the next fragment of the stream in an ack payload
+   *
+   * @param ack ack payload to fill
+   *
+   * @return size of the ack payload
+   */
+  uint8_t build_fragment(uint8_t* ack);
+  /**
+   * Send the current stream message again from the start
+   */
+  void restart_stream();
+
+  /**
+   * Get the address of a pipe.  Pipes 2 to 5 differ from the device id only
+   * in the first byte.
+   *
+   * @param pipe pipe (1 to 5)
+   * @param address 5 byte array to put the address in
+   */
+  void pipe_address(uint8_t pipe, uint8_t* address);
+  /**
+   * Open the pipes of every attached peer
+   */
+  void open_peers();
+  /**
+   * Read a packet from a peer
+   *
+   * @param pipe pipe the packet came from
+   * @param packet packet that was received
+   */
+  void read_peer(uint8_t pipe, uint8_t* packet);
+
+  /**
+   * Change the data rate and PA level of the radio
+   *
+   * @param dataRate data rate
+   * @param paLevel PA level
+   */
+  void set_link(rf24_datarate_e dataRate, uint8_t paLevel);
+
+  /**
+   * Answer a remote that is resuming the connection
+   *
+   * @param packet _PACKET_RECONNECT packet
+   *
+   * @return true if the remote has the same settings
+   */
+  bool read_resume(uint8_t* packet);
+  /**
+   * Send a packet back to the remote, then go back to listening
+   *
+   * @param data data to send
+   * @param size size of data in bytes
+   */
+  void send_reply(const void* data, uint8_t size);
+  /**
+   * Read a packet that changes the settings of the link
+   *
+   * @param packet _PACKET_UPDATE_RECVR_SETTINGS packet
+   */
+  void read_settings(uint8_t* packet);
+  /**
+   * Use new settings for the link, starting the next frame from scratch
+   *
+   * @param settings 32 byte settings
+   */
+  void switch_settings(const uint8_t* settings);
+
+  /**
+   * Start the hop sequence, waiting on the first channel for the remote
+   */
+  void hop_reset();
+  /**
+   * Move to the channel the remote should be sending on
+   *
+   * The frame the remote is on is found from the last frame number received,
+   * and the time since it was received.  Changing channels clears the ack
+   * payload, so it is loaded again.
+   */
+  void hop();
+  /**
+   * Set the place in the hop sequence from a received channel packet
+   *
+   * @param frame frame number of the packet
+   * @param time time the packet was received (micros)
+   */
+  void hop_sync(uint8_t frame, uint32_t time);
+
+  /**
+   * Add a received frame to the statistics
+   *
+   * @param now time the frame was received (micros)
+   */
+  void record_arrival(uint32_t now);
+
+  /**
+   * Check if a frame is newer than the last one received
+   *
+   * @param frame frame number of the frame
+   * @param time time the frame was received (micros)
+   *
+   * @return true if the frame is new
+   * @return false if it is a duplicate, or out of order
+   */
+  bool frame_is_new(uint8_t frame, uint32_t time);
+  /**
+   * Check if a channel packet is out of date because a newer whole frame
+   * arrived right behind it
+   *
+   * @param packet channel packet
+   * @param next packet received after it on pipe 1
+   *
+   * @return true if packet doesn't need to be decoded
+   */
+  bool superseded(uint8_t* packet, uint8_t* next);
+  /**
+   * Record the frame number of a frame that was received
+   *
+   * @param frame frame number of the frame
+   * @param time time the frame was received (micros)
+   */
+  void sequence_frame(uint8_t frame, uint32_t time);
+  /**
+   * Record a frame that set the channels
+   *
+   * @param channels channels of the frame
+   * @param packet last packet of the frame
+   * @param time time the frame was received (micros)
+   */
+  void deliver_frame(uint16_t channels[], uint8_t* packet, uint32_t time);
+
+  /**
+   * Keep a received frame for the failsafe to predict from
+   *
+   * @param channels channels of the frame
+   * @param time time the frame was received (micros)
+   */
+  void keep_frame(uint16_t channels[], uint32_t time);
+  /**
+   * Put the channels of the last frame back, before a delta is applied to
+   * channels the failsafe has changed
+   *
+   * @param channels channels to restore
+   */
+  void restore_frame(uint16_t channels[]);
+  /**
+   * Set the channels from the failsafe while frames are missing
+   *
+   * @param channels channels to set
+   *
+   * @return true if any channel was changed
+   */
+  bool apply_failsafe(uint16_t channels[]);
+  /**
+   * Get an interpolated channel
+   *
+   * @param channel index of the channel
+   * @param time time to get the channel at (micros)
+   *
+   * @return value of the channel
+   */
+  uint16_t interpolated(uint8_t channel, uint32_t time);
+  /**
+   * Start interpolating towards new channels from where the output is
+   *
+   * @param channels new channels
+   * @param time time the channels were set (micros)
+   */
+  void interpolate_to(uint16_t channels[], uint32_t time);
+
+  /**
+   * Read a channel packet
+   *
+   * Frames that are split into several packets are assembled, and the
+   * channels are only set once every packet of the frame has been read.
+   *
+   * @param packet channel packet
+   * @param channels channels to set
+   *
+   * @return true if channels were set
+   */
+  bool read_channels(uint8_t* packet, uint16_t channels[]);
+  /**
+   * Read a channel packet of a frame that is followed by a parity packet
+   *
+   * The packets of a frame can come in any order, and once all but one
+   * have been read along with the parity packet, the missing one is rebuilt
+   * from the parity.
+   *
+   * @param packet channel or parity packet
+   * @param channels channels to set
+   *
+   * @return true if channels were set
+   */
+  bool read_coded(uint8_t* packet, uint16_t channels[]);
+
+  /**
+   * Read a delta packet, and set the channels that have changed
+   *
+   * Only read deltas once a full frame has been received, since a delta
+   * means nothing without the frame it is based on.
+   *
+   * @param packet delta packet
+   * @param channels channels to set
+   */
+  void read_delta(uint8_t* packet, uint16_t channels[]);
+  /**
+   * Read a primary packet, and set the primary channels
+   *
+   * Like deltas, only read primary packets once a full frame has been
+   * received, which holds the aux channels.
+   *
+   * @param packet primary packet
+   * @param channels channels to set
+   */
+  void read_primary(uint8_t* packet, uint16_t channels[]);
 
 };
 
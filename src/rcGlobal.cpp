@@ -10,6 +10,16 @@ RCGlobal::RCGlobal() {
   _pairSettings.setStartChannel(63);
   _pairSettings.setPayloadSize(32);
   _pairSettings.setRetryDelay(7);
+
+  for(uint8_t i = 0; i < RC_HOP_CHANNELS; i++) {
+    _hopSequence[i] = 0;
+  }
+
+  _handshakeState = 0;
+  _handshakeTimer = 0;
+  _retryTimer = 0;
+
+  reset_stats();
 }
 
 int8_t RCGlobal::force_send(void* buf, uint8_t size, unsigned long timeout) {
@@ -28,7 +38,7 @@ int8_t RCGlobal::force_send(void* buf, uint8_t size, unsigned long timeout) {
 int8_t RCGlobal::wait_till_available(unsigned long timeout) {
   uint32_t t = millis();
   while(!_radio->available() && millis() - t < timeout) {
-    delay(16);
+    delay(1);
   }
   if(millis() - t >= timeout) {
     return -1;
@@ -37,6 +47,134 @@ int8_t RCGlobal::wait_till_available(unsigned long timeout) {
   return 0;
 }
 
+void RCGlobal::reset_stats() {
+  memset(&_stats, 0, sizeof(_stats));
+  _lossAverage = 0;
+}
+
+void RCGlobal::record_frame(bool lost) {
+  if(lost) {
+    _stats.framesLost++;
+  }
+
+  //Exponential moving average with a weight of 1/16
+  int32_t target = lost ? (100L << 8) : 0;
+  _lossAverage += (target - _lossAverage) / 16;
+  _stats.loss = (_lossAverage + 128) >> 8;
+}
+
+void RCGlobal::record_jitter(uint32_t deviation) {
+  uint8_t bucket = 0;
+  uint32_t limit = 125;
+
+  while(deviation >= limit && bucket < RC_JITTER_BUCKETS - 1) {
+    limit <<= 1;
+    bucket++;
+  }
+
+  //Stop counting rather than overflowing
+  if(_stats.jitter[bucket] < 0xFFFF) {
+    _stats.jitter[bucket]++;
+  }
+}
+
+void RCGlobal::record_latency(uint32_t latency) {
+  uint8_t bucket = 0;
+
+  while(latency >= latency_limit(bucket) && bucket < RC_LATENCY_BUCKETS - 1) {
+    bucket++;
+  }
+
+  //Stop counting rather than overflowing
+  if(_stats.latency[bucket] < 0xFFFF) {
+    _stats.latency[bucket]++;
+  }
+}
+
+uint32_t RCGlobal::latency_limit(uint8_t bucket) {
+  //Even buckets end on a power of two, odd buckets halfway to the next
+  if(bucket & 1) {
+    return 96UL << (bucket >> 1);
+  }
+  return 64UL << (bucket >> 1);
+}
+
+uint32_t RCGlobal::latency_percentile(uint8_t percent) {
+  uint32_t total = 0;
+  for(uint8_t i = 0; i < RC_LATENCY_BUCKETS; i++) {
+    total += _stats.latency[i];
+  }
+  if(total == 0) {
+    return 0;
+  }
+
+  //Number of latencies at or below the percentile, at least one
+  uint32_t target = (total * min(percent, 100) + 99) / 100;
+  if(target == 0) {
+    target = 1;
+  }
+
+  uint32_t count = 0;
+  for(uint8_t i = 0; i < RC_LATENCY_BUCKETS; i++) {
+    count += _stats.latency[i];
+    if(count >= target) {
+      return latency_limit(i);
+    }
+  }
+  return latency_limit(RC_LATENCY_BUCKETS - 1);
+}
+
+void RCGlobal::write_time(uint8_t* buf, uint32_t time) {
+  for(uint8_t i = 0; i < 4; i++) {
+    buf[i] = time >> (i * 8);
+  }
+}
+
+uint32_t RCGlobal::read_time(const uint8_t* buf) {
+  uint32_t time = 0;
+  for(uint8_t i = 0; i < 4; i++) {
+    time |= (uint32_t)buf[i] << (i * 8);
+  }
+  return time;
+}
+
+void RCGlobal::start_send(const void* buf, uint8_t size) {
+  _radio->startWrite(buf, size, false);
+}
+
+int8_t RCGlobal::check_send() {
+  bool sent, failed, received;
+  _radio->whatHappened(sent, failed, received);
+
+  if(sent) {
+    return 1;
+  }
+  if(failed) {
+    _radio->flush_tx();
+    return -1;
+  }
+  return 0;
+}
+
+void RCGlobal::handshake_step(uint8_t state) {
+  _handshakeState = state;
+  _handshakeTimer = millis();
+  _retryTimer = _handshakeTimer;
+}
+
+void RCGlobal::handshake_retry(uint8_t state) {
+  _handshakeState = state;
+  _retryTimer = millis();
+}
+
+bool RCGlobal::handshake_timeout(unsigned long timeout) {
+  return millis() - _handshakeTimer >= timeout;
+}
+
+bool RCGlobal::retry_timeout(unsigned long timeout) {
+  return millis() - _retryTimer >= timeout;
+}
+
 void RCGlobal::apply_settings(RCSettings* settings) {
   //Enable/disable Dynamic Payloads, and set payload size
   if(settings->getEnableDynamicPayload()) {
@@ -67,4 +205,151 @@ void RCGlobal::flush_buffer() {
   while(_radio->available()) {
     _radio->read(&tmp, 1);
   }
+}
+
+uint8_t RCGlobal::channel_header(RCSettings* settings) {
+  //The first two bytes of the packet are the packet type and frame number
+  if(settings->getEnableTimestamps()) {
+    return 2 + _TIMESTAMP_SIZE;
+  }
+  return 2;
+}
+
+uint8_t RCGlobal::channels_per_packet(RCSettings* settings) {
+  uint8_t fit = (settings->getPayloadSize() - channel_header(settings)) * 8 /
+                settings->getChannelResolution();
+  return min(fit, settings->getNumChannels());
+}
+
+uint8_t RCGlobal::packets_per_frame(RCSettings* settings) {
+  //With no channels there is still a packet to send
+  uint8_t perPacket = max(channels_per_packet(settings), 1);
+  uint8_t packets = (settings->getNumChannels() + perPacket - 1) / perPacket;
+  return constrain(packets, 1, _PACKET_CHANNELS_INDEX + 1);
+}
+
+bool RCGlobal::error_correction(RCSettings* settings) {
+  return settings->getEnableErrorCorrection() && !settings->getEnableAck();
+}
+
+bool RCGlobal::parity_packet(RCSettings* settings) {
+  //A frame of one packet has every channel, so the next frame makes up for
+  //it, unless it is a keyframe that deltas or primary frames depend on.
+  uint8_t packets = packets_per_frame(settings);
+  return error_correction(settings) && packets <= _PACKET_CHANNELS_INDEX &&
+         (packets > 1 || settings->getKeyframeInterval() > 0 ||
+          primary_channels(settings) > 0);
+}
+
+uint8_t RCGlobal::primary_channels(RCSettings* settings) {
+  uint8_t primary = min(settings->getPrimaryChannels(),
+                        channels_per_packet(settings));
+  //With every channel primary, there is nothing left to send less often
+  if(primary >= min(settings->getNumChannels(), RC_MAX_CHANNELS)) {
+    return 0;
+  }
+  return primary;
+}
+
+uint8_t RCGlobal::packet_size(RCSettings* settings, uint8_t used) {
+  if(settings->getEnableDynamicPayload()) {
+    return used;
+  }
+  return settings->getPayloadSize();
+}
+
+uint16_t RCGlobal::frame_cycle() {
+  if(_settings.getHopInterval() == 0) {
+    return 256;
+  }
+  return RC_HOP_CHANNELS * _settings.getHopInterval();
+}
+
+void RCGlobal::build_hop_sequence(const uint8_t* remoteId,
+                                  const uint8_t* deviceId) {
+  //Seed a linear congruential generator with the link, so both ends make the
+  //same sequence.
+  uint32_t seed = _settings.getStartChannel();
+  for(uint8_t i = 0; i < 5; i++) {
+    seed = seed * 31 + remoteId[i];
+    seed = seed * 31 + deviceId[i];
+  }
+
+  for(uint8_t i = 0; i < RC_HOP_CHANNELS; i++) {
+    bool used = true;
+
+    //Pick channels until one is found that isn't already in the sequence
+    while(used) {
+      seed = seed * 1103515245 + 12345;
+      _hopSequence[i] = (seed >> 16) % (RC_HOP_MAX_CHANNEL + 1);
+
+      used = false;
+      for(uint8_t j = 0; j < i; j++) {
+        if(_hopSequence[j] == _hopSequence[i]) {
+          used = true;
+          break;
+        }
+      }
+    }
+  }
+}
+
+uint8_t RCGlobal::hop_channel(uint8_t frame) {
+  if(_settings.getHopInterval() == 0) {
+    return _settings.getStartChannel();
+  }
+  return _hopSequence[(frame / _settings.getHopInterval()) % RC_HOP_CHANNELS];
+}
+
+uint8_t RCGlobal::checksum(const uint8_t* data, uint8_t size, uint8_t crc) {
+  //CRC-8 with the polynomial x^8 + x^2 + x + 1
+  for(uint8_t i = 0; i < size; i++) {
+    crc ^= data[i];
+    for(uint8_t bit = 0; bit < 8; bit++) {
+      crc = (crc & 0x80) ? (crc << 1) ^ 0x07 : crc << 1;
+    }
+  }
+
+  return crc;
+}
+
+void RCGlobal::pack_channels(uint8_t* buf, const uint16_t* channels,
+                             uint8_t numChannels, uint8_t bits) {
+  uint16_t maxValue = 0xFFFF >> (16 - bits);
+  uint32_t bitBuffer = 0;
+  uint8_t bitCount = 0;
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    bitBuffer = (bitBuffer << bits) | min(channels[i], maxValue);
+    bitCount += bits;
+
+    //Write out every full byte
+    while(bitCount >= 8) {
+      bitCount -= 8;
+      *buf++ = bitBuffer >> bitCount;
+    }
+  }
+
+  //Left align the remaining bits in the last byte
+  if(bitCount > 0) {
+    *buf = bitBuffer << (8 - bitCount);
+  }
+}
+
+void RCGlobal::unpack_channels(const uint8_t* buf, uint16_t* channels,
+                               uint8_t numChannels, uint8_t bits) {
+  uint16_t maxValue = 0xFFFF >> (16 - bits);
+  uint32_t bitBuffer = 0;
+  uint8_t bitCount = 0;
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    //Read in bytes until there is a full channel
+    while(bitCount < bits) {
+      bitBuffer = (bitBuffer << 8) | *buf++;
+      bitCount += 8;
+    }
+
+    bitCount -= bits;
+    channels[i] = (bitBuffer >> bitCount) & maxValue;
+  }
 }
\ No newline at end of file
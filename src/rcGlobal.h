@@ -15,6 +15,61 @@
 #define RC_CONNECT_TIMEOUT 2500
 #endif
 
+/**
+ * How long (millis) a link with adapted or changed settings may go without a
+ * frame before both devices fall back to the last settings that worked.
+ */
+#ifndef RC_ADAPT_TIMEOUT
+#define RC_ADAPT_TIMEOUT 250
+#endif
+
+/**
+ * The most channels a device can receive.  Channel frames that need more than
+ * one packet are assembled in a buffer of this size before being delivered.
+ */
+#ifndef RC_MAX_CHANNELS
+#define RC_MAX_CHANNELS 32
+#endif
+
+/**
+ * Number of buckets in RCStats::jitter.  Bucket 0 counts deviations under
+ * 125us, and each bucket after doubles, with the last counting everything
+ * larger.
+ */
+#ifndef RC_JITTER_BUCKETS
+#define RC_JITTER_BUCKETS 8
+#endif
+
+/**
+ * Number of buckets in RCStats::latency.  Bucket 0 counts latencies under
+ * 64us, and the buckets after grow by half an octave each (96us, 128us,
+ * 192us, ...), with the last counting everything larger.
+ */
+#ifndef RC_LATENCY_BUCKETS
+#define RC_LATENCY_BUCKETS 24
+#endif
+
+/**
+ * Number of channels in the hop sequence, see RCSettings.setHopInterval()
+ *
+ * The frame number is a single byte, so there can be no more than 17.
+ */
+#ifndef RC_HOP_CHANNELS
+#define RC_HOP_CHANNELS 16
+#endif
+
+#if RC_HOP_CHANNELS > 17
+#error "RC_HOP_CHANNELS must be no more than 17"
+#endif
+
+/**
+ * Highest radio channel the hop sequence may use.  Channel 83 is 2483MHz,
+ * the top of the 2.4GHz ISM band.
+ */
+#ifndef RC_HOP_MAX_CHANNEL
+#define RC_HOP_MAX_CHANNEL 83
+#endif
+
 //Global Error Constants
 
 /**
@@ -42,6 +97,89 @@
  */
 #define RC_ERROR_ALREADY_CONNECTED -22
 
+//Global Info Constants
+
+/**
+ * The handshake started by beginPair() or beginConnect() is still running,
+ * keep calling pollHandshake()
+ */
+#define RC_INFO_HANDSHAKE_PENDING 11
+
+/**
+ * Statistics about the health of a link
+ *
+ * See RemoteProtocol::getStats() and DeviceProtocol::getStats().  A frame is
+ * one set of channels, which can be sent in more than one packet.
+ */
+struct RCStats {
+  /**
+   * Frames sent by the remote, or received by the device
+   */
+  uint32_t frames;
+  /**
+   * Frames that were acknowledged (remote only)
+   */
+  uint32_t framesAcked;
+  /**
+   * Frames that were lost.  The remote counts frames that were not
+   * acknowledged, the device counts gaps between frames longer than the
+   * comms period.
+   */
+  uint32_t framesLost;
+  /**
+   * Automatic retransmissions, read from the radio after each frame (remote
+   * only)
+   */
+  uint32_t retransmits;
+  /**
+   * Frames that were acknowledged with telemetry.  The device counts the
+   * ack payloads taken by its remote.
+   */
+  uint32_t ackPayloads;
+  /**
+   * Telemetry stream messages that were cut off because a fragment was lost,
+   * or #RC_STREAM_BUFFER was full (remote only)
+   */
+  uint32_t streamLost;
+  /**
+   * Frames that returned #RC_INFO_TICK_TOO_SHORT (remote only)
+   */
+  uint32_t tickOverruns;
+  /**
+   * Frames that were dropped since they were duplicates of, or older than,
+   * a frame already received (device only)
+   */
+  uint32_t framesStale;
+  /**
+   * Frames that weren't decoded since a newer frame arrived right behind
+   * them (device only)
+   */
+  uint32_t framesSkipped;
+  /**
+   * Frames that were rebuilt from their parity packet, see
+   * RCSettings.setEnableErrorCorrection() (device only)
+   */
+  uint32_t framesRecovered;
+  /**
+   * Histogram of timing deviations, see #RC_JITTER_BUCKETS.  The remote
+   * counts how late each frame was sent after its slot, the device counts how
+   * far the time between frames was from the comms period.
+   */
+  uint16_t jitter[RC_JITTER_BUCKETS];
+  /**
+   * Histogram of frame latencies when RCSettings.setEnableTimestamps() is
+   * enabled, see #RC_LATENCY_BUCKETS.  The remote counts the round trip time
+   * of each acknowledged frame, the device counts the time from the remote
+   * sending a frame to update() reading it.
+   */
+  uint16_t latency[RC_LATENCY_BUCKETS];
+  /**
+   * Rolling percentage of lost frames, averaged over about the last 16
+   * frames
+   */
+  uint8_t loss;
+};
+
 /**
  * Contains functions and variables used by both DeviceProtocal and
  * RemoteProtocol.
@@ -62,10 +200,73 @@ protected:
   const uint8_t _NACK = 0x15;
   const uint8_t _TEST = 0x02;
 
+  /*
+   * The low nibble of a channel packet is split into the frame toggle
+   * (0x08) which flips every frame, and the index of the packet in the
+   * frame (0x07) for frames that are sent in more than one packet.
+   *
+   * The second byte of every channel and delta packet is the frame number,
+   * which counts up to frame_cycle().
+   */
   const uint8_t _PACKET_CHANNELS = 0xA0;
-  const uint8_t _PACKET_UPDATE_TRANS_SETTINGS = 0xB1;//TODO: Implement
-  const uint8_t _PACKET_UPDATE_RECVR_SETTINGS = 0xB2;//TODO: Implement
+  const uint8_t _PACKET_CHANNELS_TOGGLE = 0x08;
+  const uint8_t _PACKET_CHANNELS_INDEX = 0x07;
+  /*
+   * A delta packet has a bitmask of the channels in the packet, followed by
+   * the changed channels.  With error correction, the toggle of the keyframe
+   * it is based on is kept in the low nibble.
+   */
+  const uint8_t _PACKET_CHANNELS_DELTA = 0x90;
+  /*
+   * A primary packet has only the primary channels, packed the same as a
+   * channel packet.  The rest of the channels are kept from the last frame.
+   */
+  const uint8_t _PACKET_CHANNELS_PRIMARY = 0xD0;
+  /*
+   * With timestamps enabled, the frame number of channel and delta packets
+   * is followed by the time the remote sent the frame, in the device's clock
+   * (0 until the clocks are synced).  Telemetry ack payloads start (after the
+   * stream header) with the number of the last frame the device received, and the
+   * time it arrived: [frame, time].  Times are 4 bytes, low byte first.
+   */
+  const uint8_t _TIMESTAMP_SIZE = 4;
+  const uint8_t _ACK_TIMING_SIZE = 5;
+  /*
+   * Change the radio settings of the device: [type, data rate, PA level].
+   * The device falls back to the connection settings if it goes
+   * RC_ADAPT_TIMEOUT without a frame.
+   */
+  const uint8_t _PACKET_UPDATE_TRANS_SETTINGS = 0xB1;
+  /*
+   * Change the settings of the link.  [type, offset, data] sends part of the
+   * new settings, [type, _SETTINGS_COMMIT, checksum] switches both ends to
+   * them, and [type, _SETTINGS_TEST, checksum] checks the link once
+   * switched.  The device replies to the test with [_ACK, checksum] of the
+   * settings it is using.  The device goes back to the old settings if it
+   * goes RC_ADAPT_TIMEOUT without a frame after switching.
+   */
+  const uint8_t _PACKET_UPDATE_RECVR_SETTINGS = 0xB2;
+  const uint8_t _SETTINGS_COMMIT = 0xFF;
+  const uint8_t _SETTINGS_TEST = 0xFE;
+  /*
+   * With the telemetry stream enabled, every ack payload starts with a
+   * header.  Normal telemetry has a header of 0, anything else is a fragment
+   * of a stream message: [header, size, data].  The header of a fragment has
+   * flags for the first and last fragment of a message, and a sequence
+   * number that counts every fragment.
+   */
+  const uint8_t _STREAM_TELEMETRY = 0x00;
+  const uint8_t _STREAM_FRAGMENT = 0x80;
+  const uint8_t _STREAM_FIRST = 0x40;
+  const uint8_t _STREAM_LAST = 0x20;
+  const uint8_t _STREAM_SEQUENCE = 0x1F;
   const uint8_t _PACKET_DISCONNECT = 0xC0;
+  /*
+   * Resume a connection without a handshake: [type, nonce, digest], where the
+   * digest is the checksum of the settings starting from the nonce.  The
+   * device replies [_ACK, digest] using the nonce with its bits flipped, or
+   * _NACK if its settings differ.  Peers only send the type.
+   */
   const uint8_t _PACKET_RECONNECT = 0xCA;
 
   RCSettings _settings;
@@ -73,6 +274,25 @@ protected:
 
   RF24* _radio;
 
+  uint8_t _hopSequence[RC_HOP_CHANNELS];
+
+  RCStats _stats;
+  //loss average, in 1/256 percent
+  uint16_t _lossAverage;
+
+  //Handshake variables, used by beginPair(), beginConnect(), and
+  //pollHandshake()
+  uint8_t _handshakeState;
+  uint32_t _handshakeTimer;
+  //when the current try of a handshake state began
+  uint32_t _retryTimer;
+
+  /**
+   * How long (millis) to listen for a reply before sending again, when there
+   * are no acks to tell if the other side is listening.
+   */
+  const uint8_t _REPLY_WAIT = 5;
+
   /**
    * repeatidly send a packet of buf until the packet has been received.
    *
@@ -91,6 +311,112 @@ protected:
    */
   int8_t wait_till_available(unsigned long timeout);
 
+  /**
+   * Clear all statistics
+   */
+  void reset_stats();
+  /**
+   * Add the result of a frame to the statistics
+   *
+   * @param lost true if the frame was lost
+   */
+  void record_frame(bool lost);
+  /**
+   * Add a timing deviation to the jitter histogram
+   *
+   * @param deviation time in micros
+   */
+  void record_jitter(uint32_t deviation);
+  /**
+   * Add a frame latency to the latency histogram
+   *
+   * @param latency time in micros
+   */
+  void record_latency(uint32_t latency);
+  /**
+   * Get the upper limit of a bucket of the latency histogram
+   *
+   * @param bucket
+   *
+   * @return latency in micros
+   */
+  uint32_t latency_limit(uint8_t bucket);
+  /**
+   * Find a percentile of the latency histogram
+   *
+   * @param percent 0-100
+   *
+   * @return upper limit of the bucket the percentile falls in (micros)
+   * @return 0 if no latencies have been recorded
+   */
+  uint32_t latency_percentile(uint8_t percent);
+  /**
+   * Write a time into a packet, low byte first
+   *
+   * @param buf where to write the 4 bytes
+   * @param time
+   */
+  void write_time(uint8_t* buf, uint32_t time);
+  /**
+   * Read a time written by write_time()
+   *
+   * @param buf
+   *
+   * @return time
+   */
+  uint32_t read_time(const uint8_t* buf);
+
+  /**
+   * Start sending a packet without waiting for it to be sent.
+   *
+   * Use check_send() to find out when the packet has been sent.
+   *
+   * @param buf data to send
+   * @param size size of data in bytes
+   */
+  void start_send(const void* buf, uint8_t size);
+  /**
+   * Check on a packet started with start_send()
+   *
+   * If the packet failed, it is removed from the radio so a new packet can
+   * be sent.
+   *
+   * @return 1 if the packet was sent
+   * @return 0 if the packet is still being sent
+   * @return -1 if the packet was not acknowledged
+   */
+  int8_t check_send();
+
+  /**
+   * Move the handshake to the given state, and restart the handshake timer.
+   *
+   * @param state next state
+   */
+  void handshake_step(uint8_t state);
+  /**
+   * Move the handshake to the given state for another try, without
+   * restarting the handshake timer.
+   *
+   * @param state next state
+   */
+  void handshake_retry(uint8_t state);
+  /**
+   * Check if the current handshake state has taken too long
+   *
+   * @param timeout how long the state may take (millis)
+   *
+   * @return true if the state has run for at least timeout
+   */
+  bool handshake_timeout(unsigned long timeout);
+  /**
+   * Check if the current try of a handshake state has taken too long
+   *
+   * @param timeout how long the try may take (millis)
+   *
+   * @return true if the try has run for at least timeout
+   */
+  bool retry_timeout(unsigned long timeout);
+
   /**
    * apply the given settings to the radio
    *
@@ -102,6 +428,139 @@ protected:
    * Flush the radio's input buffer
    */
   void flush_buffer();
+
+  /**
+   * Get the number of bytes before the channels of a channel packet
+   *
+   * @param settings
+   *
+   * @return header size in bytes
+   */
+  uint8_t channel_header(RCSettings* settings);
+  /**
+   * Get the number of channels that fit in one channel packet
+   *
+   * @param settings
+   *
+   * @return number of channels
+   */
+  uint8_t channels_per_packet(RCSettings* settings);
+  /**
+   * Get the number of packets needed to send every channel.
+   *
+   * A frame is never split into more than 8 packets.
+   *
+   * @param settings
+   *
+   * @return number of packets
+   */
+  uint8_t packets_per_frame(RCSettings* settings);
+  /**
+   * Check if frames are sent with forward error correction, which is only
+   * used without acks
+   *
+   * @param settings
+   *
+   * @return true if delta frames hold every change since the last keyframe
+   */
+  bool error_correction(RCSettings* settings);
+  /**
+   * Check if the packets of a frame are followed by a parity packet
+   *
+   * The parity packet has the index after the last packet of the frame, and
+   * its channel bytes are the XOR of those of every packet in the frame, so
+   * the parity of a single packet is a copy of it.  A frame of 8 packets has
+   * no index left for one.
+   *
+   * @param settings
+   *
+   * @return true if frames have a parity packet
+   */
+  bool parity_packet(RCSettings* settings);
+  /**
+   * Get the number of channels that are sent every frame
+   *
+   * The primary channels are limited to what fits in one packet.
+   *
+   * @param settings
+   *
+   * @return number of primary channels, or 0 if every channel is sent every
+   * frame
+   */
+  uint8_t primary_channels(RCSettings* settings);
+
+  /**
+   * Get the number of bytes to send for a packet
+   *
+   * @param settings
+   * @param used number of bytes of the packet that are used
+   *
+   * @note the packet must be a full payload size buffer, since static
+   * payloads send all of it.  Write short replies at their real size, and
+   * RF24 pads them.
+   *
+   * @return used if dynamic payloads are enabled, otherwise the payload size
+   */
+  uint8_t packet_size(RCSettings* settings, uint8_t used);
+
+  /**
+   * Get the number of frames before the frame number starts over
+   *
+   * When hopping, this is one pass through the hop sequence.
+   *
+   * @return number of frame numbers
+   */
+  uint16_t frame_cycle();
+  /**
+   * Make the hop sequence from the settings, and the ids of both ends
+   *
+   * @param remoteId 5 byte id of the remote
+   * @param deviceId 5 byte id of the device
+   */
+  void build_hop_sequence(const uint8_t* remoteId, const uint8_t* deviceId);
+  /**
+   * Get the radio channel a frame is sent on
+   *
+   * @param frame frame number
+   *
+   * @return the start channel if hopping is disabled
+   */
+  uint8_t hop_channel(uint8_t frame);
+
+  /**
+   * Get the CRC-8 of some data
+   *
+   * @param data data to check
+   * @param size size of data in bytes
+   * @param crc value to start from, so a challenge can be mixed in
+   *
+   * @return checksum
+   */
+  uint8_t checksum(const uint8_t* data, uint8_t size, uint8_t crc = 0);
+
+  /**
+   * Pack channels into buf, each channel using bits bits, most significant
+   * bit first.  Values too large for bits are clamped.
+   *
+   * At 16 bits this is the same as writing each channel big-endian.
+   *
+   * @param buf buffer of at least (numChannels * bits + 7) / 8 bytes
+   * @param channels channels to pack
+   * @param numChannels number of channels to pack
+   * @param bits resolution of each channel (1 to 16)
+   */
+  void pack_channels(uint8_t* buf, const uint16_t* channels, uint8_t numChannels,
+                     uint8_t bits);
+  /**
+   * Unpack channels packed with pack_channels()
+   *
+   * @param buf packed channels
+   * @param channels array to put numChannels channels in
+   * @param numChannels number of channels to unpack
+   * @param bits resolution of each channel (1 to 16)
+   */
+  void unpack_channels(const uint8_t* buf, uint16_t* channels,
+                       uint8_t numChannels, uint8_t bits);
 };
 
 #endif
\ No newline at end of file
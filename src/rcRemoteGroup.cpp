@@ -0,0 +1,146 @@
+#include <RF24.h>
+
+#include "rcRemoteGroup.h"
+
+RemoteGroup::RemoteGroup() {
+  _size = 0;
+  _last = 0;
+
+  for(uint8_t i = 0; i < RC_GROUP_SIZE; i++) {
+    _remotes[i] = NULL;
+    _status[i] = 0;
+    _frameTime[i] = 0;
+  }
+}
+
+int8_t RemoteGroup::add(RemoteProtocol* remote) {
+  if(_size >= RC_GROUP_SIZE) {
+    return -1;
+  }
+
+  _remotes[_size] = remote;
+  _status[_size] = 0;
+  _frameTime[_size] = 0;
+
+  return _size++;
+}
+
+uint8_t RemoteGroup::getSize() {
+  return _size;
+}
+
+bool RemoteGroup::poll() {
+  for(uint8_t i = 0; i < _size; i++) {
+    if(_remotes[i]->poll()) {
+      return true;
+    }
+  }
+  return false;
+}
+
+int8_t RemoteGroup::next_remote() {
+  int8_t next = -1;
+  uint32_t nextTime = 0;
+
+  //Start after the last remote sent, so remotes that are due at the same
+  //time take turns.
+  for(uint8_t n = 1; n <= _size; n++) {
+    uint8_t i = (_last + n) % _size;
+
+    if(!_remotes[i]->isConnected()) {
+      continue;
+    }
+
+    uint32_t time = _remotes[i]->getTimeUntilNextSlot();
+    if(next == -1 || time < nextTime) {
+      next = i;
+      nextTime = time;
+    }
+  }
+
+  return next;
+}
+
+void RemoteGroup::separate_slots(uint8_t index) {
+  uint32_t start = _remotes[index]->getTimeUntilNextSlot();
+  uint32_t end = start + _frameTime[index];
+
+  for(uint8_t i = 0; i < _size; i++) {
+    if(i == index || !_remotes[i]->isConnected()) {
+      continue;
+    }
+
+    //If the slots overlap, move the other remote to after this one
+    uint32_t otherStart = _remotes[i]->getTimeUntilNextSlot();
+    if(otherStart < end && otherStart + _frameTime[i] > start) {
+      _remotes[i]->delaySlot(end - otherStart);
+    }
+  }
+}
+
+int8_t RemoteGroup::update(uint16_t* channels[], uint8_t* telemetry[]) {
+  return send_next(channels, NULL, telemetry);
+}
+
+int8_t RemoteGroup::update(RemoteProtocol::sampleChannels* sampleChannels[],
+                           uint8_t* telemetry[]) {
+  return send_next(NULL, sampleChannels, telemetry);
+}
+
+int8_t RemoteGroup::send_next(uint16_t* channels[],
+                              RemoteProtocol::sampleChannels* sampleChannels[],
+                              uint8_t* telemetry[]) {
+  int8_t index = next_remote();
+
+  if(index == -1) {
+    return RC_ERROR_NOT_CONNECTED;
+  }
+
+  RemoteProtocol* remote = _remotes[index];
+
+  //wait until the remote's slot
+  while(!remote->poll());
+
+  uint32_t time = micros();
+
+  //Another remote, or a handshake, may have changed the radio
+  if(_size > 1) {
+    remote->activate();
+  }
+
+  if(channels) {
+    _status[index] = remote->update(channels[index], telemetry[index]);
+  } else {
+    _status[index] = remote->update(sampleChannels[index], telemetry[index]);
+  }
+
+  //Exponential moving average with a weight of 1/8
+  time = micros() - time;
+  if(_frameTime[index] == 0) {
+    _frameTime[index] = time;
+  } else {
+    _frameTime[index] += ((int32_t)time - (int32_t)_frameTime[index]) / 8;
+  }
+
+  _last = index;
+  separate_slots(index);
+
+  return index;
+}
+
+int8_t RemoteGroup::getStatus(uint8_t index) {
+  return _status[index];
+}
+
+uint16_t RemoteGroup::getLoad() {
+  uint32_t load = 0;
+
+  for(uint8_t i = 0; i < _size; i++) {
+    if(_remotes[i]->isConnected()) {
+      load += _frameTime[i] * _remotes[i]->getSettings()->getCommsFrequency();
+    }
+  }
+
+  //micros per second to percent
+  return load / 10000;
+}
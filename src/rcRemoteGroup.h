@@ -0,0 +1,173 @@
+/*
+   rcRemoteGroup.h - Several remotes sharing one radio for RCProtocol.
+*/
+
+#ifndef __RCREMOTEGROUP_H__
+#define __RCREMOTEGROUP_H__
+
+#include <RF24.h>
+
+#include "rcRemoteProtocol.h"
+
+
+//Userdefined Constants
+
+/**
+ * The most remotes a RemoteGroup can hold
+ */
+#ifndef RC_GROUP_SIZE
+#define RC_GROUP_SIZE 4
+#endif
+
+
+/**
+ * Drive several devices at once from one radio
+ *
+ * Each device is connected through its own RemoteProtocol, and every
+ * RemoteProtocol is given the same RF24.  The group sends each remote's
+ * frames in its own slot, and keeps the slots of different remotes from
+ * landing on top of each other, so every device keeps its own
+ * RCSettings.setCommsFrequency().
+ *
+ * Pair and connect each remote as usual.  Since a handshake changes the
+ * radio, the group applies a remote's settings before every frame whenever
+ * it holds more than one remote.
+ *
+ * @code
+ * RemoteProtocol vehicle(&radio, remoteId);
+ * RemoteProtocol gimbal(&radio, remoteId);
+ * RemoteGroup group;
+ *
+ * group.add(&vehicle);
+ * group.add(&gimbal);
+ *
+ * uint16_t* channels[] = {vehicleChannels, gimbalChannels};
+ * uint8_t* telemetry[] = {vehicleTelemetry, NULL};
+ *
+ * int8_t index = group.update(channels, telemetry);
+ * @endcode
+ */
+class RemoteGroup {
+public:
+  /**
+   * Constructor
+   */
+  RemoteGroup();
+
+  /**
+   * Add a remote to the group
+   *
+   * @param remote remote sharing the radio with the rest of the group
+   *
+   * @return index of the remote, used for update() and getStatus()
+   * @return -1 if the group already holds #RC_GROUP_SIZE remotes
+   */
+  int8_t add(RemoteProtocol* remote);
+
+  /**
+   * Get the number of remotes in the group
+   *
+   * @return number of remotes
+   */
+  uint8_t getSize();
+
+  /**
+   * Check if it is time to send a frame for any connected remote
+   *
+   * @return true if a slot is due
+   */
+  bool poll();
+
+  /**
+   * Send the next frame
+   *
+   * This holds until the earliest slot of the connected remotes is due, and
+   * then sends that remote's channels.  Call it in a loop, and every remote
+   * will be sent at its own comms frequency.
+   *
+   * @param channels channel arrays for each remote, in the order they were
+   * added
+   * @param telemetry telemetry arrays for each remote, entries may be NULL
+   *
+   * @return index of the remote that was sent, see getStatus() for what
+   * RemoteProtocol::update() returned
+   * @return #RC_ERROR_NOT_CONNECTED if no remote is connected
+   */
+  int8_t update(uint16_t* channels[], uint8_t* telemetry[]);
+  /**
+   * Send the next frame, reading the channels just before they are sent
+   *
+   * The same as update(), but each remote's channels are read by its
+   * RemoteProtocol::sampleChannels() once its slot is due.
+   *
+   * @param sampleChannels functions to read the channels of each remote, in
+   * the order they were added
+   * @param telemetry telemetry arrays for each remote, entries may be NULL
+   *
+   * @return see update()
+   */
+  int8_t update(RemoteProtocol::sampleChannels* sampleChannels[],
+                uint8_t* telemetry[]);
+
+  /**
+   * Get what RemoteProtocol::update() returned for the last frame of a
+   * remote
+   *
+   * @param index index of the remote
+   *
+   * @return status of the last frame
+   */
+  int8_t getStatus(uint8_t index);
+
+  /**
+   * Get the share of air time the connected remotes use
+   *
+   * Found from the average time it takes to send each remote's frame, and
+   * its comms frequency.  Over 100, the slots can't all fit and frames will
+   * return #RC_INFO_TICK_TOO_SHORT.
+   *
+   * @return percent of the time spent sending frames
+   */
+  uint16_t getLoad();
+
+private:
+
+  RemoteProtocol* _remotes[RC_GROUP_SIZE];
+  int8_t _status[RC_GROUP_SIZE];
+  //average time to send a frame for each remote (micros)
+  uint32_t _frameTime[RC_GROUP_SIZE];
+  uint8_t _size;
+  //index of the last remote sent
+  uint8_t _last;
+
+  /**
+   * Get the connected remote with the earliest slot
+   *
+   * @return index of the remote, or -1 if none are connected
+   */
+  int8_t next_remote();
+
+  /**
+   * Move the slots of other remotes that would overlap with a remote's next
+   * slot
+   *
+   * @param index remote that was just sent
+   */
+  void separate_slots(uint8_t index);
+
+  /**
+   * Send the frame of the remote with the earliest slot
+   *
+   * @param channels channel arrays for each remote, or NULL
+   * @param sampleChannels functions to read the channels of each remote,
+   * used if channels is NULL
+   * @param telemetry telemetry arrays for each remote
+   *
+   * @return see update()
+   */
+  int8_t send_next(uint16_t* channels[],
+                   RemoteProtocol::sampleChannels* sampleChannels[],
+                   uint8_t* telemetry[]);
+};
+
+#endif
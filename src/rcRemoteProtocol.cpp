@@ -4,15 +4,63 @@
 #include "rcRemoteProtocol.h"
 #include "rcSettings.h"
 
+//Link levels used by adaptive link control, from fastest to most robust
+static const rf24_datarate_e ADAPT_RATES[] = {
+  RF24_2MBPS, RF24_2MBPS, RF24_1MBPS, RF24_1MBPS, RF24_250KBPS
+};
+static const uint8_t ADAPT_PA_LEVELS[] = {
+  RF24_PA_LOW, RF24_PA_HIGH, RF24_PA_HIGH, RF24_PA_MAX, RF24_PA_MAX
+};
+
 RemoteProtocol::RemoteProtocol(RF24* tranceiver, const uint8_t remoteId[]) {
   //initialize all primitive variables
   _isConnected = false;
+  _frameToggle = 0;
+  _frameNumber = 0;
+  _sinceKeyframe = 0;
+  _sinceAux = 0;
+  _telemetrySize = 0;
+  _streamUsed = 0;
+  _streamRead = 0;
+  _streamState = _STREAM_IDLE;
+  _streamSequence = 0;
+
+  _roundTrip = 0;
+  _clockSynced = false;
+  _clockOffset = 0;
+  _clockTime = 0;
+  _clockDrift = 0;
+  _driftMeasured = false;
+  _driftOffset = 0;
+  _driftTime = 0;
+
+  _adaptLevel = 0;
+  _adaptBase = 0;
+  _adaptGood = 0;
+  _adaptFrames = 0;
+  _adaptLost = 0;
+  _adaptRetransmits = 0;
+  _lastAck = 0;
 
   for(uint8_t i = 0; i < 5; i++) {
     _deviceId[i] = 0;
   }
 
-  _timer = millis();
+  for(uint8_t i = 0; i < sizeof(_deltaMask); i++) {
+    _deltaMask[i] = 0;
+  }
+
+  memset(_sentChannels, 0, sizeof(_sentChannels));
+
+  _nextSlot = 0;
+  _period = 0;
+  _periodRemainder = 0;
+  _remainder = 0;
+
+  _connectValid = false;
+  _saveSettings = NULL;
+  _checkIfValid = NULL;
+  _setLastConnection = NULL;
 
   _radio = tranceiver;
   _remoteId = remoteId;
@@ -40,62 +88,148 @@ int8_t RemoteProtocol::begin(RemoteProtocol::getLastConnection
     uint8_t settings[32];
 
     if(checkIfValid(lastId, settings)) {
+      return resume(lastId, settings);
+    }
 
-      //copy lastId to _deviceId
-      for(uint8_t i = 0; i < 5; i++) {
-        _deviceId[i] = lastId[i];
-      }
+    return -1;
 
-      _settings.setSettings(settings);
-      apply_settings(&_settings);
+  }
 
-      _radio->openWritingPipe(_deviceId);
-      _radio->openReadingPipe(1, _remoteId);
 
-      if(!_settings.getEnableAck()) {
-        //Re-connect in noAck mode
+  return 0;
 
-        _radio->write(const_cast<uint8_t*>(&_PACKET_RECONNECT), 1);
+}
 
-        _radio->startListening();
-        if(wait_till_available(100) == -1) {
-          return -1;
-        }
+int8_t RemoteProtocol::join(const uint8_t id[],
+                            RemoteProtocol::checkIfValid checkIfValid) {
+  if(isConnected()) {
+    return RC_ERROR_ALREADY_CONNECTED;
+  }
 
-        uint8_t status;
-        _radio->read(&status, 1);
+  uint8_t settings[32];
 
-        _radio->stopListening();
+  if(!checkIfValid(id, settings)) {
+    return RC_ERROR_CONNECTION_REFUSED;
+  }
 
-        if(status == _ACK) {
-          _isConnected = true;
-          return 1;
-        }
+  if(reconnect(id, settings) != 1) {
+    return RC_ERROR_TIMEOUT;
+  }
 
-      } else {
-        if(force_send(const_cast<uint8_t*>(&_PACKET_RECONNECT), 1, 100) == 0) {
-          _isConnected = true;
-          return 1;
-        }
-      }
+  return 0;
+}
+
+void RemoteProtocol::link_start(const uint8_t id[], const uint8_t settings[]) {
+  //copy id to _deviceId
+  for(uint8_t i = 0; i < 5; i++) {
+    _deviceId[i] = id[i];
+  }
+
+  _settings.setSettings(settings);
+  apply_settings(&_settings);
+
+  _radio->openWritingPipe(_deviceId);
+  _radio->openReadingPipe(1, _remoteId);
+
+  _sinceKeyframe = 0;
+  _streamState = _STREAM_IDLE;
+  _clockSynced = false;
+  //The sampler starts from these until the first frame is sent
+  memset(_sentChannels, 0, sizeof(_sentChannels));
+  start_timer();
+  adapt_reset();
+  hop_reset();
+}
+
+int8_t RemoteProtocol::resume(const uint8_t id[], const uint8_t settings[]) {
+  link_start(id, settings);
+
+  uint8_t nonce = micros();
+  uint8_t challenge[3] = {
+    _PACKET_RECONNECT, nonce, checksum(settings, 32, nonce)
+  };
+  uint8_t expected = checksum(settings, 32, ~nonce);
+  uint32_t start = millis();
+
+  //The device may still be waking up, so keep trying
+  while(millis() - start < RC_CONNECT_TIMEOUT) {
+    //With acks, there is no need to wait for a device that isn't there
+    if(!_radio->write(challenge, 3) &&
+       _settings.getEnableAck()) {
+      continue;
     }
 
-    return -1;
+    //Drop any ack payload, so only the reply is read
+    flush_buffer();
 
+    _radio->startListening();
+    uint8_t reply[2] = {0, 0};
+    if(wait_till_available(10) == 0) {
+      _radio->read(reply, 2);
+    }
+    _radio->stopListening();
+
+    if(reply[0] == _ACK && reply[1] == expected) {
+      _isConnected = true;
+      return 1;
+    } else if(reply[0] == _NACK) {
+      //The device has different settings
+      return -1;
+    }
   }
 
+  return -1;
+}
 
-  return 0;
+int8_t RemoteProtocol::reconnect(const uint8_t id[], const uint8_t settings[]) {
+  link_start(id, settings);
+
+  if(!_settings.getEnableAck()) {
+    //Re-connect in noAck mode
+
+    _radio->write(const_cast<uint8_t*>(&_PACKET_RECONNECT), 1);
+
+    _radio->startListening();
+    if(wait_till_available(100) == -1) {
+      return -1;
+    }
+
+    uint8_t status;
+    _radio->read(&status, 1);
+
+    _radio->stopListening();
+
+    if(status == _ACK) {
+      _isConnected = true;
+      return 1;
+    }
 
+  } else {
+    if(force_send(const_cast<uint8_t*>(&_PACKET_RECONNECT), 1, 100) == 0) {
+      _isConnected = true;
+      return 1;
+    }
+  }
+
+  return -1;
 }
 
 int8_t RemoteProtocol::pair(RemoteProtocol::saveSettings saveSettings) {
+  int8_t status = beginPair(saveSettings);
+
+  while(status == RC_INFO_HANDSHAKE_PENDING) {
+    status = pollHandshake();
+  }
+
+  return status;
+}
+
+int8_t RemoteProtocol::beginPair(RemoteProtocol::saveSettings saveSettings) {
   if(isConnected()) {
     return RC_ERROR_ALREADY_CONNECTED;
   }
 
-  uint8_t settings[32];
-  uint8_t deviceId[5];
+  _saveSettings = saveSettings;
 
   _radio->setPALevel(RF24_PA_LOW);
 
@@ -108,48 +242,31 @@ int8_t RemoteProtocol::pair(RemoteProtocol::saveSettings saveSettings) {
   flush_buffer();
 
   //Send the remote's id until a receiver has acknowledged
-  if(force_send(const_cast<uint8_t*>(_remoteId), 5, RC_TIMEOUT) != 0) {
-    return RC_ERROR_TIMEOUT;
-  }
+  start_send(_remoteId, 5);
+  handshake_step(_PAIR_SEND_ID);
 
-  //Start listening for the device to send data back
-  _radio->openReadingPipe(1, _remoteId);
-  _radio->startListening();
-
-  //wait until data is available, if it takes too long, error lost connection
-  if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-    return RC_ERROR_LOST_CONNECTION;
-  }
-
-  //read the deviceId
-  _radio->read(&deviceId, 5);
+  return RC_INFO_HANDSHAKE_PENDING;
+}
 
+int8_t RemoteProtocol::connect(RemoteProtocol::checkIfValid checkIfValid,
+                               RemoteProtocol::setLastConnection setLastConnection) {
+  int8_t status = beginConnect(checkIfValid, setLastConnection);
 
-  //wait until data is available, if it takes too long, error lost connection
-  if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-    return RC_ERROR_LOST_CONNECTION;
+  while(status == RC_INFO_HANDSHAKE_PENDING) {
+    status = pollHandshake();
   }
 
-  //Read the settings to settings
-  _radio->read(settings, 32);
-
-  //Save settings
-  saveSettings(deviceId, settings);
-
-  _radio->stopListening();
-
-  return 0;
+  return status;
 }
 
-int8_t RemoteProtocol::connect(RemoteProtocol::checkIfValid checkIfValid,
-                               RemoteProtocol::setLastConnection setLastConnection) {
+int8_t RemoteProtocol::beginConnect(RemoteProtocol::checkIfValid checkIfValid,
+                                    RemoteProtocol::setLastConnection setLastConnection) {
   if(isConnected()) {
     return RC_ERROR_ALREADY_CONNECTED;
   }
 
-  uint8_t settings[32];
-  uint8_t testData = 0;
-  bool valid = false;
+  _checkIfValid = checkIfValid;
+  _setLastConnection = setLastConnection;
 
   //reset connected because if we fail connecting, we will not be connected
   //to anything.
@@ -165,98 +282,217 @@ int8_t RemoteProtocol::connect(RemoteProtocol::checkIfValid checkIfValid,
 
   _radio->startListening();
 
-  //Wait for communications, timeout error if it takes too long
-  if(wait_till_available(RC_TIMEOUT) != 0) {
-    return RC_ERROR_TIMEOUT;
+  handshake_step(_CONNECT_WAIT_ID);
+
+  return RC_INFO_HANDSHAKE_PENDING;
+}
+
+int8_t RemoteProtocol::pollHandshake() {
+  if(_handshakeState == _HANDSHAKE_IDLE) {
+    return isConnected() ? 0 : RC_ERROR_NOT_CONNECTED;
   }
 
-  //Read the device ID
-  _radio->read(&_deviceId, 5);
+  if(_handshakeState < _CONNECT_WAIT_ID) {
+    return poll_pair();
+  }
+  return poll_connect();
+}
 
-  //Check if we can pair with the device
-  valid = checkIfValid(_deviceId, settings);
-  _settings.setSettings(settings);
+int8_t RemoteProtocol::handshake_end(int8_t status) {
+  _handshakeState = _HANDSHAKE_IDLE;
+  return status;
+}
 
-  //Start Writing
-  _radio->stopListening();
+int8_t RemoteProtocol::poll_pair() {
+  uint8_t settings[32];
+  int8_t sent;
 
-  //We now know who we will be writing to, so open the writing pipe
-  _radio->openWritingPipe(_deviceId);
+  switch(_handshakeState) {
+  case _PAIR_SEND_ID:
+    sent = check_send();
 
-  //Delay so that the device has time to switch modes
-  delay(200);
+    if(sent == 1) {
+      //Start listening for the device to send data back
+      _radio->openReadingPipe(1, _remoteId);
+      _radio->startListening();
 
-  //If the device is allowed to connect, send the _ACK command, else _NACK
-  if(valid) {
-    if(_radio->write(const_cast<uint8_t*>(&_ACK), 1) == false) {
-      return RC_ERROR_LOST_CONNECTION;
+      handshake_step(_PAIR_WAIT_ID);
+    } else if(handshake_timeout(RC_TIMEOUT)) {
+      _radio->flush_tx();
+      return handshake_end(RC_ERROR_TIMEOUT);
+    } else if(sent == -1) {
+      //Nobody is listening yet, try again.
+      start_send(_remoteId, 5);
     }
-  } else {
-    if(_radio->write(const_cast<uint8_t*>(&_NACK), 1) == false) {
-      return RC_ERROR_LOST_CONNECTION;
+    break;
+
+  case _PAIR_WAIT_ID:
+    if(_radio->available()) {
+      //read the deviceId
+      _radio->read(&_deviceId, 5);
+
+      handshake_step(_PAIR_WAIT_SETTINGS);
+    } else if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+      return handshake_end(RC_ERROR_LOST_CONNECTION);
     }
-    return RC_ERROR_CONNECTION_REFUSED;
+    break;
+
+  case _PAIR_WAIT_SETTINGS:
+    if(_radio->available()) {
+      //Read the settings to settings
+      _radio->read(settings, 32);
+
+      //Save settings
+      _saveSettings(_deviceId, settings);
+
+      _radio->stopListening();
+
+      return handshake_end(0);
+    } else if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+      return handshake_end(RC_ERROR_LOST_CONNECTION);
+    }
+    break;
   }
 
-  //Set the radio settings to the settings specified by the receiver.
-  apply_settings(&_settings);
+  return RC_INFO_HANDSHAKE_PENDING;
+}
+
+int8_t RemoteProtocol::poll_connect() {
+  uint8_t settings[32];
+  uint8_t testData = 0;
+  int8_t sent;
+
+  switch(_handshakeState) {
+  case _CONNECT_WAIT_ID:
+    if(_radio->available()) {
+      //Read the device ID
+      _radio->read(&_deviceId, 5);
+
+      //Check if we can pair with the device
+      _connectValid = _checkIfValid(_deviceId, settings);
+      if(_connectValid) {
+        _settings.setSettings(settings);
+      }
 
-  _radio->setPALevel(RF24_PA_HIGH);
+      //Start Writing
+      _radio->stopListening();
 
-  delay(200);
+      //We now know who we will be writing to, so open the writing pipe
+      _radio->openWritingPipe(_deviceId);
 
-  //Test if the settings were set correctly.
+      //If the device is allowed to connect, send the _ACK command, else
+      //_NACK.  It is sent as soon as the device starts listening.
+      start_send(_connectValid ? &_ACK : &_NACK, 1);
+      handshake_step(_CONNECT_SEND_REPLY);
+    } else if(handshake_timeout(RC_TIMEOUT)) {
+      _radio->stopListening();
+      return handshake_end(RC_ERROR_TIMEOUT);
+    }
+    break;
 
-  if(_settings.getEnableAck()) {
-    if(_settings.getEnableAckPayload()) {
-      //Test when ack payloads are enabled.
-      if(_radio->write(const_cast<uint8_t*>(&_TEST), 1) == false) {
-        return RC_ERROR_LOST_CONNECTION;
+  case _CONNECT_SEND_REPLY:
+    sent = check_send();
+
+    if(sent == -1) {
+      if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+        return handshake_end(RC_ERROR_LOST_CONNECTION);
+      }
+      //The device isn't listening yet, try again.
+      start_send(_connectValid ? &_ACK : &_NACK, 1);
+    } else if(sent == 1) {
+      if(!_connectValid) {
+        return handshake_end(RC_ERROR_CONNECTION_REFUSED);
       }
 
-      if(_radio->available()) {
-        _radio->read(&testData, 1);
+      //Set the radio settings to the settings specified by the receiver.
+      apply_settings(&_settings);
+
+      _radio->setPALevel(RF24_PA_HIGH);
+
+      //Test if the settings were set correctly.
+      start_send(&_TEST, 1);
+      handshake_step(_CONNECT_SEND_TEST);
+    }
+    break;
 
-        if(testData != _TEST) {
-          return RC_ERROR_BAD_DATA;
+  case _CONNECT_SEND_TEST:
+    sent = check_send();
+
+    if(sent == 0) {
+      break;
+    }
+
+    if(_settings.getEnableAck()) {
+      if(sent == -1) {
+        if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+          return handshake_end(RC_ERROR_LOST_CONNECTION);
         }
-      } else {
-        return RC_ERROR_BAD_DATA;
+        //The device hasn't switched to the new settings yet, try again.
+        start_send(&_TEST, 1);
+        break;
       }
 
-    } else {
-
-      //Test When Ack Payloads are disabled
-      if(_radio->write(const_cast<uint8_t*>(&_TEST), 1) == false) {
-        return RC_ERROR_BAD_DATA;
+      //Test when ack payloads are enabled.
+      if(_settings.getEnableAckPayload()) {
+        if(_radio->available()) {
+          _radio->read(&testData, 1);
+
+          if(testData != _TEST) {
+            return handshake_end(RC_ERROR_BAD_DATA);
+          }
+        } else {
+          return handshake_end(RC_ERROR_BAD_DATA);
+        }
       }
+
+      return handshake_end(connect_finish());
     }
-  } else {
-    //Test when acks are disabled
-    _radio->write(&_TEST, 1);
 
+    //Test when acks are disabled, the device sends the test back
     _radio->startListening();
+    handshake_retry(_CONNECT_WAIT_TEST);
+    break;
 
-    if(wait_till_available(RC_CONNECT_TIMEOUT) != 0) {
-      return RC_ERROR_LOST_CONNECTION;
-    }
+  case _CONNECT_WAIT_TEST:
+    if(_radio->available()) {
+      _radio->read(&testData, 1);
 
-    _radio->read(&testData, 1);
+      _radio->stopListening();
 
-    if(testData != _TEST) {
-      return RC_ERROR_BAD_DATA;
-    }
+      if(testData != _TEST) {
+        return handshake_end(RC_ERROR_BAD_DATA);
+      }
 
-    _radio->stopListening();
+      return handshake_end(connect_finish());
+    } else if(handshake_timeout(RC_CONNECT_TIMEOUT)) {
+      _radio->stopListening();
+      return handshake_end(RC_ERROR_LOST_CONNECTION);
+    } else if(retry_timeout(_REPLY_WAIT)) {
+      //Either the device wasn't listening yet, or its reply was lost
+      _radio->stopListening();
+      start_send(&_TEST, 1);
+      handshake_retry(_CONNECT_SEND_TEST);
+    }
+    break;
   }
 
-  setLastConnection(_deviceId);
+  return RC_INFO_HANDSHAKE_PENDING;
+}
+
+int8_t RemoteProtocol::connect_finish() {
+  _setLastConnection(_deviceId);
 
   //We passed all of the tests, so we are connected.
   _isConnected = true;
-  //set timer delay as a variable once so it doesn't need to be recalculated
-  //every update
-  _timerDelay = round(1000.0 / _settings.getCommsFrequency());
+  //The device has no channels yet, so start with a keyframe
+  _sinceKeyframe = 0;
+  _streamState = _STREAM_IDLE;
+  _clockSynced = false;
+  //The sampler starts from these until the first frame is sent
+  memset(_sentChannels, 0, sizeof(_sentChannels));
+  start_timer();
+  adapt_reset();
+  hop_reset();
 
   return 0;
 }
@@ -265,6 +501,166 @@ bool RemoteProtocol::isConnected() {
   return _isConnected;
 }
 
+bool RemoteProtocol::poll() {
+  return isConnected() && (int32_t)(micros() - _nextSlot) >= 0;
+}
+
+uint32_t RemoteProtocol::getTimeUntilNextSlot() {
+  int32_t time = _nextSlot - micros();
+  return time > 0 ? time : 0;
+}
+
+void RemoteProtocol::delaySlot(uint32_t time) {
+  _nextSlot += time;
+}
+
+void RemoteProtocol::activate() {
+  apply_settings(&_settings);
+
+  _radio->openWritingPipe(_deviceId);
+  _radio->openReadingPipe(1, _remoteId);
+
+  if(_settings.getEnableAdaptive()) {
+    set_link_level(_adaptLevel);
+  } else {
+    _radio->setPALevel(RF24_PA_HIGH);
+    if(_settings.getHopInterval() > 0) {
+      set_retries(_settings.getRetryDelay());
+    }
+  }
+
+  _radio->setChannel(hop_channel(_frameNumber));
+}
+
+void RemoteProtocol::adapt_reset() {
+  switch(_settings.getDataRate()) {
+  case RF24_2MBPS:
+    _adaptBase = 1;
+    break;
+  case RF24_250KBPS:
+    _adaptBase = 4;
+    break;
+  case RF24_1MBPS:
+  default:
+    _adaptBase = 2;
+    break;
+  }
+
+  _adaptGood = 0;
+  adapt_window();
+  _lastAck = millis();
+
+  if(_settings.getEnableAdaptive()) {
+    set_link_level(_adaptBase);
+  } else {
+    _adaptLevel = _adaptBase;
+  }
+}
+
+void RemoteProtocol::adapt_window() {
+  _adaptFrames = 0;
+  _adaptLost = _stats.framesLost;
+  _adaptRetransmits = _stats.retransmits;
+}
+
+void RemoteProtocol::set_link_level(uint8_t level) {
+  _adaptLevel = level;
+
+  _radio->setDataRate(ADAPT_RATES[level]);
+  _radio->setPALevel(ADAPT_PA_LEVELS[level]);
+
+  //250KBPS needs more time for the ack payload, see RCSettings.setRetryDelay()
+  set_retries(ADAPT_RATES[level] == RF24_250KBPS ? 5 : 1);
+}
+
+void RemoteProtocol::set_retries(uint8_t retryDelay) {
+  //Only retry for as long as half of a tick
+  uint32_t count = (_period / 2) / ((retryDelay + 1) * 250);
+  _radio->setRetries(retryDelay, constrain(count, 1, 15));
+}
+
+void RemoteProtocol::adapt(int8_t status) {
+  if(!_settings.getEnableAdaptive() || !_settings.getEnableAck()) {
+    return;
+  }
+
+  if(status >= 0) {
+    _lastAck = millis();
+  }
+
+  //If the device can't be heard, it will have fallen back, so follow it.
+  if(_adaptLevel != _adaptBase && millis() - _lastAck >= RC_ADAPT_TIMEOUT) {
+    set_link_level(_adaptBase);
+    _adaptGood = 0;
+    adapt_window();
+    return;
+  }
+
+  if(++_adaptFrames < _ADAPT_WINDOW) {
+    return;
+  }
+
+  uint32_t lost = _stats.framesLost - _adaptLost;
+  uint32_t retransmits = _stats.retransmits - _adaptRetransmits;
+  uint8_t maxLevel = _radio->isPVariant() ? 4 : 3;
+  uint8_t level = _adaptLevel;
+
+  if(lost * 10 > _adaptFrames || retransmits > _adaptFrames * 4) {
+    //More than 10% loss, or 4 retries a frame: more range is needed
+    _adaptGood = 0;
+    if(level < max(maxLevel, _adaptBase)) {
+      level++;
+    }
+  } else if(lost == 0 && retransmits * 2 < _adaptFrames) {
+    //A clean link for several windows in a row can go faster
+    if(++_adaptGood >= _ADAPT_GOOD_WINDOWS) {
+      _adaptGood = 0;
+      if(level > 0) {
+        level--;
+      }
+    }
+  } else {
+    _adaptGood = 0;
+  }
+
+  adapt_window();
+
+  if(level != _adaptLevel) {
+    uint8_t packet[3] = {
+      _PACKET_UPDATE_TRANS_SETTINGS, ADAPT_RATES[level], ADAPT_PA_LEVELS[level]
+    };
+
+    //Only change once the device has the new settings
+    if(send_packet(packet, 3) == 0) {
+      set_link_level(level);
+    }
+  }
+}
+
+void RemoteProtocol::start_timer() {
+  _period = 1000000 / _settings.getCommsFrequency();
+  _periodRemainder = 1000000 % _settings.getCommsFrequency();
+  _remainder = 0;
+  _nextSlot = micros();
+}
+
+void RemoteProtocol::hop_reset() {
+  build_hop_sequence(_remoteId, _deviceId);
+  _frameNumber = 0;
+  _radio->setChannel(hop_channel(_frameNumber));
+
+  //The frame numbers start over, so forget the frames already sent
+  for(uint8_t i = 0; i < _TIMING_FRAMES; i++) {
+    _timing[i].acked = false;
+  }
+
+  //The device moves on half way through a tick, so a frame that is still
+  //being retried by then would be lost anyway.
+  if(_settings.getHopInterval() > 0 && !_settings.getEnableAdaptive()) {
+    set_retries(_settings.getRetryDelay());
+  }
+}
+
 int8_t RemoteProtocol::send_packet(void* data, uint8_t dataSize,
                                    void* telemetry, uint8_t telemetrySize) {
   if(isConnected()) {
@@ -289,71 +685,595 @@ int8_t RemoteProtocol::send_packet(void* data, uint8_t dataSize,
   }
 }
 
-int8_t RemoteProtocol::update(uint16_t channels[], uint8_t telemetry[]) {
+uint8_t RemoteProtocol::build_delta(uint8_t* packet, uint16_t channels[]) {
+  uint8_t numChannels = _settings.getNumChannels();
+  uint8_t maskSize = (numChannels + 7) / 8;
+  uint8_t bits = _settings.getChannelResolution();
+  uint8_t header = channel_header(&_settings);
+  //number of changed channels that fit after the header and bitmask
+  uint16_t space = (_settings.getPayloadSize() - header - maskSize) * 8 / bits;
+  uint16_t changed[RC_MAX_CHANNELS];
+  uint8_t numChanged = 0;
+
+  //Delta frames need a copy of the last frame, and the bitmask to fit.
+  if(numChannels > RC_MAX_CHANNELS ||
+     maskSize + header > _settings.getPayloadSize()) {
+    return 0;
+  }
 
-  if(!isConnected()) {
-    return RC_ERROR_NOT_CONNECTED;
+  for(uint8_t i = 0; i < _settings.getPayloadSize(); i++) {
+    packet[i] = 0;
   }
 
-  uint8_t packet[_settings.getPayloadSize()];
+  packet[0] = _PACKET_CHANNELS_DELTA;
+  if(error_correction(&_settings)) {
+    packet[0] |= _frameToggle;
+  }
+  packet[1] = _frameNumber;
+  write_timestamp(packet);
+
+  for(uint8_t i = 0; i < numChannels; i++) {
+    //A channel that was in a delta may have been lost with it, so it stays
+    //in every delta until the next keyframe
+    if(channels[i] != _sentChannels[i] ||
+       (_deltaMask[i / 8] & (0x80 >> (i % 8)))) {
+      if(numChanged >= space) {
+        return 0;
+      }
+      packet[header + i / 8] |= 0x80 >> (i % 8);
+      changed[numChanged++] = channels[i];
+    }
+  }
 
-  uint8_t i = 0;
+  pack_channels(packet + header + maskSize, changed, numChanged, bits);
 
-  //Set the Packet type
-  packet[i++] = _PACKET_CHANNELS + 0;
-  //Set the payload data
-  for(; i < min(_settings.getPayloadSize(), _settings.getNumChannels() * 2 + 1);
-      i += 2) {
-    packet[i] = (channels[(i - 1) / 2] >> 8) & 0x00FF;
-    packet[i + 1] = channels[(i - 1) / 2] & 0x00FF;
-  }
-  //Set the rest of the packet to 0.
-  for(; i < _settings.getPayloadSize(); i++) {
+  return header + maskSize + (numChanged * bits + 7) / 8;
+}
+
+uint8_t RemoteProtocol::build_primary(uint8_t* packet, uint16_t channels[]) {
+  uint8_t count = primary_channels(&_settings);
+  uint8_t bits = _settings.getChannelResolution();
+  uint8_t header = channel_header(&_settings);
+
+  for(uint8_t i = 0; i < _settings.getPayloadSize(); i++) {
     packet[i] = 0;
   }
 
+  packet[0] = _PACKET_CHANNELS_PRIMARY;
+  packet[1] = _frameNumber;
+  write_timestamp(packet);
 
-  //Send the packet.
-  int8_t status = send_packet(packet,
-                              sizeof(uint8_t) * _settings.getPayloadSize(),
-                              telemetry, sizeof(uint8_t) * _settings.getPayloadSize());
+  pack_channels(packet + header, channels, count, bits);
 
+  return header + (count * bits + 7) / 8;
+}
 
-  //If the tick was too long, and there are no errors, set the return to Tick To Short
-  if(millis() - _timer > _timerDelay && status >= 0) {
-    status = RC_INFO_TICK_TOO_SHORT;
+bool RemoteProtocol::aux_due() {
+  if(primary_channels(&_settings) == 0) {
+    return true;
   }
-  //wait until The Comms Frequency delay has passed.
-  while(millis() - _timer < _timerDelay) {
-    delay(1);
+
+  //Round the aux period to whole frames
+  uint16_t interval = _settings.getCommsFrequency() /
+                      _settings.getAuxFrequency();
+  return _sinceAux + 1 >= interval;
+}
+
+int8_t RemoteProtocol::send_frame(uint16_t channels[], uint8_t telemetry[]) {
+  uint8_t packet[32] = {0};
+  uint8_t perPacket = channels_per_packet(&_settings);
+  uint8_t packets = packets_per_frame(&_settings);
+  uint8_t header = channel_header(&_settings);
+  uint8_t size = 0;
+  bool sent = true;
+  bool keyframe = true;
+  bool primary = false;
+  uint8_t parity[32] = {0};
+  FrameTiming* timing = &_timing[_frameNumber % _TIMING_FRAMES];
+
+  timing->frame = _frameNumber;
+  timing->acked = false;
+  if(_settings.getEnableTimestamps()) {
+    timing->sent = micros();
   }
 
-  _timer = millis();
+  //Move to the channel of this frame
+  if(_settings.getHopInterval() > 0) {
+    _radio->setChannel(hop_channel(_frameNumber));
+  }
+
+  //Send only the primary channels until the aux channels are due, and only
+  //the changed channels if a keyframe isn't due
+  if(_sinceKeyframe > 0 && !aux_due()) {
+    size = build_primary(packet, channels);
+    primary = true;
+  } else if(_settings.getKeyframeInterval() > 0 && _sinceKeyframe > 0 &&
+      _sinceKeyframe < _settings.getKeyframeInterval()) {
+    size = build_delta(packet, channels);
+  }
+
+  if(size > 0) {
+    keyframe = false;
+    sent = _radio->writeFast(packet, packet_size(&_settings, size));
+    packets = 0;
+  }
+  timing->clean = packets <= 1;
+
+  //Flip the toggle so the device can tell this frame from the last one.
+  if(keyframe) {
+    _frameToggle ^= _PACKET_CHANNELS_TOGGLE;
+  }
+
+  //Queue every packet of the frame in the TX FIFO, so the packets are sent
+  //back to back rather than waiting for each one to be acknowledged.
+  for(uint8_t p = 0; p < packets && sent; p++) {
+    uint8_t first = p * perPacket;
+    uint8_t count = min(perPacket, _settings.getNumChannels() - first);
+
+    //Clear the packet so the unused space is sent as 0.
+    for(uint8_t i = 0; i < _settings.getPayloadSize(); i++) {
+      packet[i] = 0;
+    }
+
+    //Set the Packet type
+    packet[0] = _PACKET_CHANNELS | _frameToggle | p;
+    packet[1] = _frameNumber;
+    write_timestamp(packet);
+    //Set the payload data
+    pack_channels(packet + header, channels + first, count,
+                  _settings.getChannelResolution());
+
+    size = header + (count * _settings.getChannelResolution() + 7) / 8;
+    sent = _radio->writeFast(packet, packet_size(&_settings, size));
+
+    for(uint8_t i = header; i < _settings.getPayloadSize(); i++) {
+      parity[i] ^= packet[i];
+    }
+  }
+
+  //Follow the frame with its parity packet, so the device can rebuild any
+  //one packet that is lost
+  if(packets > 0 && parity_packet(&_settings) && sent) {
+    parity[0] = _PACKET_CHANNELS | _frameToggle | packets;
+    parity[1] = _frameNumber;
+    write_timestamp(parity);
+
+    size = header + (perPacket * _settings.getChannelResolution() + 7) / 8;
+    sent = _radio->writeFast(parity, packet_size(&_settings, size));
+  }
+
+  //Wait for the FIFO to be sent, if a packet failed it is flushed.
+  sent = _radio->txStandBy() && sent;
+
+  uint8_t retransmits = 0;
+  if(_settings.getEnableAck()) {
+    //Only the last packet's retransmits are kept by the radio
+    retransmits = _radio->getARC();
+  }
+
+  if(sent && _settings.getEnableAck() && _settings.getEnableTimestamps()) {
+    timing->received = micros();
+    timing->acked = true;
+    timing->clean = timing->clean && retransmits == 0;
+    _roundTrip = timing->received - timing->sent;
+    record_latency(_roundTrip);
+  }
+
+  //The frame number counts every frame, even the lost ones, so the device
+  //can keep hopping on time.
+  _frameNumber = (_frameNumber + 1) % frame_cycle();
+
+  _stats.frames++;
+  if(_settings.getEnableAck()) {
+    _stats.retransmits += retransmits;
+    record_frame(!sent);
+  }
+
+  if(!sent && _settings.getEnableAck()) {
+    //We were expecting at least an ack, but did not get one.  The next delta
+    //frame will still be based on the last acknowledged frame.
+    return RC_ERROR_PACKET_NOT_SENT;
+  }
+
+  //The device now has these channels, so the next delta is based on them.
+  uint8_t numSent = primary ? primary_channels(&_settings) :
+                    min(_settings.getNumChannels(), RC_MAX_CHANNELS);
+  for(uint8_t i = 0; i < numSent; i++) {
+    _sentChannels[i] = channels[i];
+  }
+
+  //Keyframes are counted by the frames that have the aux channels
+  if(primary) {
+    _sinceAux++;
+  } else {
+    _sinceKeyframe = keyframe ? 1 : _sinceKeyframe + 1;
+    _sinceAux = 0;
+  }
+
+  //Deltas can be lost without acks, so remember which channels were sent in
+  //one.  A keyframe sends them all.
+  for(uint8_t i = 0; i < sizeof(_deltaMask); i++) {
+    if(keyframe) {
+      _deltaMask[i] = 0;
+    } else if(!primary && error_correction(&_settings) &&
+              i < (_settings.getNumChannels() + 7) / 8) {
+      _deltaMask[i] |= packet[header + i];
+    }
+  }
+
+  if(_settings.getEnableAck()) {
+    _stats.framesAcked++;
+  }
+
+  return read_acks(telemetry);
+}
+
+int8_t RemoteProtocol::read_acks(uint8_t telemetry[]) {
+  //Each packet can have an ack payload, keep the newest telemetry.  Every
+  //payload is read, since stream fragments are spread among them.
+  int8_t status = 0;
+  bool received = false;
+  while(_radio->available()) {
+    uint8_t size = _settings.getPayloadSize();
+    if(_settings.getEnableDynamicPayload()) {
+      size = min(_radio->getDynamicPayloadSize(), size);
+    }
+
+    uint8_t ack[32];
+    _radio->read(ack, size);
+    received = true;
+
+    if(read_ack(ack, size, telemetry)) {
+      status = 1;
+    }
+  }
+
+  if(received) {
+    _stats.ackPayloads++;
+  }
 
   return status;
 }
 
+bool RemoteProtocol::read_ack(uint8_t* ack, uint8_t size, uint8_t telemetry[]) {
+  uint8_t header = 0;
+
+  if(_settings.getEnableStream()) {
+    if(size == 0) {
+      return false;
+    }
+    if(ack[0] & _STREAM_FRAGMENT) {
+      read_fragment(ack, size);
+      return false;
+    }
+    header = 1;
+  }
+
+  if(_settings.getEnableTimestamps()) {
+    if(size < header + _ACK_TIMING_SIZE) {
+      return false;
+    }
+    read_timing(ack + header);
+    header += _ACK_TIMING_SIZE;
+  }
+
+  if(!telemetry) {
+    return false;
+  }
+
+  _telemetrySize = size - header;
+  memcpy(telemetry, ack + header, _telemetrySize);
+
+  return true;
+}
+
+void RemoteProtocol::read_timing(uint8_t* ack) {
+  FrameTiming* timing = &_timing[ack[0] % _TIMING_FRAMES];
+  uint32_t arrival = read_time(ack + 1);
+
+  //The device hasn't received a frame yet, or the frame is no longer kept
+  if(arrival == 0 || !timing->acked || timing->frame != ack[0]) {
+    return;
+  }
+
+  //Only a single packet that got through the first time is known to arrive
+  //half way through the round trip
+  if(!timing->clean) {
+    return;
+  }
+
+  uint32_t half = (timing->received - timing->sent) / 2;
+  uint32_t middle = timing->sent + half;
+  sync_clock(arrival - middle, middle, half);
+
+  //Each frame is only used once
+  timing->acked = false;
+}
+
+void RemoteProtocol::sync_clock(uint32_t offset, uint32_t time,
+                                uint32_t bound) {
+  int32_t error = offset - clock_offset(time);
+
+  //The first measurement, or the device's clock has started over
+  if(!_clockSynced || error > _CLOCK_RESYNC || error < -_CLOCK_RESYNC) {
+    _clockOffset = offset;
+    _clockTime = time;
+    _clockDrift = 0;
+    _driftMeasured = false;
+    _driftOffset = offset;
+    _driftTime = time;
+    _clockSynced = true;
+    return;
+  }
+
+  //The packet arrived somewhere in the round trip, so an error larger than
+  //that is the device reading it late.  Exponential moving average with a
+  //weight of 1/8, so a late packet only moves the clock a little.
+  error = constrain(error, -(int32_t)bound, (int32_t)bound);
+  _clockOffset = clock_offset(time) + error / 8;
+  _clockTime = time;
+
+  //Measure the drift from how far the offset moved over the drift period,
+  //and average it with a weight of 1/4 so late packets even out
+  uint32_t elapsed = time - _driftTime;
+  if(elapsed >= _DRIFT_PERIOD) {
+    int32_t moved = _clockOffset - _driftOffset;
+    int32_t drift = moved * 1000L / (int32_t)(elapsed / 1000);
+    if(_driftMeasured) {
+      _clockDrift += (drift - _clockDrift) / 4;
+    } else {
+      _clockDrift = drift;
+      _driftMeasured = true;
+    }
+    _driftOffset = _clockOffset;
+    _driftTime = time;
+  }
+}
+
+uint32_t RemoteProtocol::clock_offset(uint32_t time) {
+  //The drift is in ppm, so scale by millis.  The product is kept in 64
+  //bits, since a link can go a long time without a sync.
+  int32_t elapsed = (time - _clockTime) / 1000;
+  return _clockOffset + (int64_t)elapsed * _clockDrift / 1000;
+}
+
+uint32_t RemoteProtocol::getRoundTripTime() {
+  return _roundTrip;
+}
+
+uint32_t RemoteProtocol::getLatencyPercentile(uint8_t percent) {
+  return latency_percentile(percent);
+}
+
+uint32_t RemoteProtocol::getLinkTime() {
+  if(!_clockSynced) {
+    return 0;
+  }
+  uint32_t now = micros();
+  return now + clock_offset(now);
+}
+
+int32_t RemoteProtocol::getClockDrift() {
+  return _clockDrift;
+}
+
+void RemoteProtocol::write_timestamp(uint8_t* packet) {
+  if(!_settings.getEnableTimestamps()) {
+    return;
+  }
+
+  //The time the frame is sent in the link clock, or 0 if there is none yet
+  uint32_t now = micros();
+  write_time(packet + 2, _clockSynced ? now + clock_offset(now) : 0);
+}
+
+void RemoteProtocol::read_fragment(uint8_t* ack, uint8_t size) {
+  if(size < 2) {
+    return;
+  }
+
+  uint8_t sequence = ack[0] & _STREAM_SEQUENCE;
+  uint8_t length = min(ack[1], size - 2);
+
+  //The device sends a fragment again when it can't tell if it was taken
+  if(sequence == ((_streamSequence - 1) & _STREAM_SEQUENCE)) {
+    return;
+  }
+
+  bool inOrder = sequence == _streamSequence;
+  _streamSequence = (sequence + 1) & _STREAM_SEQUENCE;
+
+  if(ack[0] & _STREAM_FIRST) {
+    //The last message never got its last fragment
+    if(_streamState == _STREAM_ASSEMBLING) {
+      _stats.streamLost++;
+    }
+    _streamState = _STREAM_ASSEMBLING;
+  } else if(_streamState != _STREAM_ASSEMBLING || !inOrder) {
+    //A fragment went missing, so drop the rest of the message.  Count it
+    //once, and wait for the first fragment of the next message.
+    if(_streamState != _STREAM_SKIPPING) {
+      _stats.streamLost++;
+    }
+    _streamState = _STREAM_SKIPPING;
+    return;
+  }
+
+  //readStream() hasn't kept up, so the rest of the message is dropped
+  if(_streamUsed + 2 + length > RC_STREAM_BUFFER) {
+    _stats.streamLost++;
+    _streamState = _STREAM_SKIPPING;
+    return;
+  }
+
+  //Fragments are stored as [header, length, data] until they are read
+  _streamBuffer[_streamUsed] = ack[0];
+  _streamBuffer[_streamUsed + 1] = length;
+  memcpy(_streamBuffer + _streamUsed + 2, ack + 2, length);
+  _streamUsed += 2 + length;
+
+  if(ack[0] & _STREAM_LAST) {
+    _streamState = _STREAM_IDLE;
+  }
+}
+
+uint16_t RemoteProtocol::getStreamAvailable() {
+  uint16_t available = 0;
+  uint16_t offset = 0;
+  uint8_t read = _streamRead;
+
+  //Count the fragments of the message being read that have arrived
+  while(offset < _streamUsed) {
+    if(offset > 0 && (_streamBuffer[offset] & _STREAM_FIRST)) {
+      break;
+    }
+    available += _streamBuffer[offset + 1] - read;
+    if(_streamBuffer[offset] & _STREAM_LAST) {
+      break;
+    }
+    offset += 2 + _streamBuffer[offset + 1];
+    read = 0;
+  }
+
+  return available;
+}
+
+uint16_t RemoteProtocol::readStream(uint8_t data[], uint16_t size,
+                                    bool* first, bool* last) {
+  uint16_t total = 0;
+  uint16_t offset = 0;
+
+  if(first) {
+    *first = _streamUsed > 0 && _streamRead == 0 &&
+             (_streamBuffer[0] & _STREAM_FIRST);
+  }
+  if(last) {
+    *last = false;
+  }
+
+  while(offset < _streamUsed && total < size) {
+    uint8_t header = _streamBuffer[offset];
+    uint8_t length = _streamBuffer[offset + 1];
+
+    //Stop at the start of the next message
+    if(total > 0 && (header & _STREAM_FIRST)) {
+      break;
+    }
+
+    uint8_t count = min(length - _streamRead, size - total);
+    memcpy(data + total, _streamBuffer + offset + 2 + _streamRead, count);
+    total += count;
+    _streamRead += count;
+
+    //Only part of the fragment fit in data
+    if(_streamRead < length) {
+      break;
+    }
+
+    offset += 2 + length;
+    _streamRead = 0;
+
+    if(header & _STREAM_LAST) {
+      if(last) {
+        *last = true;
+      }
+      break;
+    }
+  }
+
+  //Move the fragments that are left to the front
+  memmove(_streamBuffer, _streamBuffer + offset, _streamUsed - offset);
+  _streamUsed -= offset;
+
+  return total;
+}
+
+int8_t RemoteProtocol::update(uint16_t channels[], uint8_t telemetry[]) {
+
+  if(!isConnected()) {
+    return RC_ERROR_NOT_CONNECTED;
+  }
+
+  //wait until the next slot.
+  while(!poll());
+
+  record_jitter(micros() - _nextSlot);
+
+  //Send the channels.
+  int8_t status = send_frame(channels, telemetry);
+
+
+  adapt(status);
+
+  //Move to the next slot.  The remainder of 1000000 / frequency is carried
+  //over so the average frequency is exact.
+  _nextSlot += _period;
+  _remainder += _periodRemainder;
+  if(_remainder >= _settings.getCommsFrequency()) {
+    _remainder -= _settings.getCommsFrequency();
+    _nextSlot++;
+  }
+
+  //If the next slot has already passed, the tick was too long.  Start again
+  //from now instead of trying to catch up with a burst of frames.
+  if(poll()) {
+    _nextSlot = micros();
+    _stats.tickOverruns++;
+    if(status >= 0) {
+      status = RC_INFO_TICK_TOO_SHORT;
+    }
+  }
+
+  return status;
+}
+
+int8_t RemoteProtocol::update(RemoteProtocol::sampleChannels sampleChannels,
+                              uint8_t telemetry[]) {
+  if(!isConnected()) {
+    return RC_ERROR_NOT_CONNECTED;
+  }
+
+  //wait until the next slot, then read the channels right before sending
+  while(!poll());
+
+  uint16_t channels[RC_MAX_CHANNELS];
+  memcpy(channels, _sentChannels, sizeof(channels));
+  sampleChannels(channels);
+
+  return update(channels, telemetry);
+}
+
 int8_t RemoteProtocol::disconnect(RemoteProtocol::setLastConnection
                                   setLastConnection) {
-  int8_t status = send_packet((const_cast<uint8_t*>(&_PACKET_DISCONNECT)), 1);
+  //When hopping, send in the next slot so the device is on the same channel
+  if(isConnected() && _settings.getHopInterval() > 0) {
+    while(!poll());
+    _radio->setChannel(hop_channel(_frameNumber));
+  }
 
-  if(status >= 0) {
-    if(!_settings.getEnableAck()) {
-      _radio->startListening();
-      if(wait_till_available(RC_CONNECT_TIMEOUT) == 0) {
+  int8_t status = send_packet((const_cast<uint8_t*>(&_PACKET_DISCONNECT)), 1);
+  uint32_t start = millis();
 
-        uint8_t ack = 0;
-        _radio->read(&ack, 1);
+  //Without acks, the device replies.  Send again until the reply is heard,
+  //since the packet or the reply may be lost.
+  while(status >= 0 && !_settings.getEnableAck()) {
+    _radio->startListening();
+    uint8_t ack = 0;
+    if(wait_till_available(10) == 0) {
+      _radio->read(&ack, 1);
+    }
+    _radio->stopListening();
 
-        if(ack != _ACK) {
-          return RC_ERROR_PACKET_NOT_SENT;
-        }
-      } else {
-        return RC_ERROR_PACKET_NOT_SENT;
-      }
-      _radio->stopListening();
+    if(ack == _ACK) {
+      break;
+    } else if(millis() - start >= RC_CONNECT_TIMEOUT) {
+      return RC_ERROR_PACKET_NOT_SENT;
     }
 
+    status = send_packet((const_cast<uint8_t*>(&_PACKET_DISCONNECT)), 1);
+  }
+
+  if(status >= 0) {
     _isConnected = false;
 
     setLastConnection(_DISCONNECT);
@@ -362,6 +1282,129 @@ int8_t RemoteProtocol::disconnect(RemoteProtocol::setLastConnection
   return status;
 }
 
+int8_t RemoteProtocol::updateSettings(RCSettings* settings) {
+  if(!isConnected()) {
+    return RC_ERROR_NOT_CONNECTED;
+  }
+
+  //Use the next slot, so the device is listening on the right channel
+  while(!poll());
+  if(_settings.getHopInterval() > 0) {
+    _radio->setChannel(hop_channel(_frameNumber));
+  }
+
+  const uint8_t* data = settings->getSettings();
+  uint8_t chunk = _settings.getPayloadSize() - 2;
+  uint8_t packet[32] = {0};
+  int8_t status = 0;
+
+  //Send the new settings a piece at a time
+  for(uint8_t offset = 0; offset < 32 && status >= 0; offset += chunk) {
+    uint8_t size = min(chunk, 32 - offset);
+
+    packet[0] = _PACKET_UPDATE_RECVR_SETTINGS;
+    packet[1] = offset;
+    memcpy(packet + 2, data + offset, size);
+
+    status = send_packet(packet, packet_size(&_settings, size + 2));
+    read_acks(NULL);
+  }
+
+  //The device only switches if every piece arrived
+  if(status >= 0) {
+    packet[1] = _SETTINGS_COMMIT;
+    packet[2] = checksum(data, 32);
+
+    status = send_packet(packet, packet_size(&_settings, 3));
+    read_acks(NULL);
+  }
+
+  //The device didn't get the settings, so nothing has changed, only the
+  //slot has been used.
+  if(status < 0) {
+    _frameNumber = (_frameNumber + 1) % frame_cycle();
+    start_timer();
+    return status;
+  }
+
+  uint8_t oldSettings[32];
+  memcpy(oldSettings, _settings.getSettings(), 32);
+  uint8_t frameNumber = _frameNumber;
+
+  //Both ends switch before the next frame
+  switch_settings(data);
+
+  status = test_settings();
+
+  //Go back to the old settings.  If the device did switch, it will also go
+  //back once it stops hearing frames.
+  if(status < 0) {
+    switch_settings(oldSettings);
+    _frameNumber = (frameNumber + 1) % frame_cycle();
+    _radio->setChannel(hop_channel(_frameNumber));
+  }
+
+  return status;
+}
+
+void RemoteProtocol::switch_settings(const uint8_t* settings) {
+  _settings.setSettings(settings);
+  apply_settings(&_settings);
+
+  //The device has no channels in the new format yet, so start with a
+  //keyframe
+  _sinceKeyframe = 0;
+  start_timer();
+  adapt_reset();
+  hop_reset();
+}
+
+int8_t RemoteProtocol::test_settings() {
+  uint8_t packet[3] = {
+    _PACKET_UPDATE_RECVR_SETTINGS, _SETTINGS_TEST,
+    checksum(_settings.getSettings(), 32)
+  };
+  uint32_t start = millis();
+
+  //Leave the device time to hear a frame before it gives up on the settings
+  while(millis() - start < RC_ADAPT_TIMEOUT / 2) {
+    //With acks, there is no need to wait for a device that isn't there
+    if(!_radio->write(packet, 3) && _settings.getEnableAck()) {
+      continue;
+    }
+
+    //Drop any ack payload, so only the reply is read
+    flush_buffer();
+
+    _radio->startListening();
+    uint8_t reply[2] = {0, 0};
+    if(wait_till_available(5) == 0) {
+      _radio->read(reply, 2);
+    }
+    _radio->stopListening();
+
+    //The device replies with the checksum of the settings it is using, which
+    //are still the old ones if it didn't switch.
+    if(reply[0] == _ACK) {
+      return reply[1] == packet[2] ? 0 : RC_ERROR_CONNECTION_REFUSED;
+    }
+  }
+
+  return RC_ERROR_LOST_CONNECTION;
+}
+
+uint8_t RemoteProtocol::getTelemetrySize() {
+  return _telemetrySize;
+}
+
+RCStats* RemoteProtocol::getStats() {
+  return &_stats;
+}
+
+void RemoteProtocol::resetStats() {
+  reset_stats();
+}
+
 RCSettings* RemoteProtocol::getSettings() {
   return &_settings;
 }
\ No newline at end of file
@@ -19,6 +19,15 @@
 //Userdefined Constants
 //Global constants can be found in rcGlobal.h
 
+/**
+ * Size of the buffer that holds received telemetry stream fragments until
+ * they are read.  Every fragment takes two more bytes than its data, and
+ * messages of any length pass through as long as readStream() keeps up.
+ */
+#ifndef RC_STREAM_BUFFER
+#define RC_STREAM_BUFFER 64
+#endif
+
 
 //Error constants
 //Global constants can be found in rcGlobal.h
@@ -87,6 +96,19 @@ public:
    * @param id 5 byte array to save the id.
    */
   typedef void (setLastConnection)(const uint8_t* id);
+  /**
+   * Read the channels to send in a frame
+   *
+   * Given to update() instead of a channel array, and called as soon as the
+   * slot is due, right before the frame is sent.  The frame then carries
+   * inputs that are only as old as this function takes, instead of up to a
+   * whole period.  Keep it short, since it delays the frame.
+   *
+   * @param channels array of size RCSettings.setNumChannels() to set.  It
+   * holds the channels of the last frame, or 0 before the first frame, so
+   * channels that haven't changed can be left alone.
+   */
+  typedef void (sampleChannels)(uint16_t* channels);
 
   /**
    * Constructor
@@ -106,6 +128,10 @@ public:
    * When begin is called, it will check if it was disconnected before
    * it last shutdown.  If it did not disconnect, It will try to reconnect.
    *
+   * The connection is resumed straight on the connection's channel and data
+   * rate, with a challenge that the device answers if both have the same
+   * settings.  The device is given #RC_CONNECT_TIMEOUT to answer, in case it
+   * was reset as well.  If it fails, use connect() for a full handshake.
    *
    * @note There is no need to begin the RF24 driver, as this function does
    * this for you
@@ -133,6 +159,19 @@ public:
    */
   int8_t pair(saveSettings saveSettings);
 
+  /**
+   * Start pairing with a receiver without waiting for it to finish
+   *
+   * This does the same as pair(), but returns straight away.  Call
+   * pollHandshake() until it no longer returns #RC_INFO_HANDSHAKE_PENDING.
+   *
+   * @param saveSettings A function pointer to save the settings of the paired device.
+   *
+   * @return #RC_INFO_HANDSHAKE_PENDING if pairing has started
+   * @return #RC_ERROR_ALREADY_CONNECTED if the remote is already connected.
+   */
+  int8_t beginPair(saveSettings saveSettings);
+
   /**
    * Attempt to connect with a previously paired device
    *
@@ -151,6 +190,53 @@ public:
    */
   int8_t connect(checkIfValid checkIfValid, setLastConnection setLastConnection);
 
+  /**
+   * Start connecting with a previously paired device without waiting for it
+   * to finish
+   *
+   * This does the same as connect(), but returns straight away.  Call
+   * pollHandshake() until it no longer returns #RC_INFO_HANDSHAKE_PENDING.
+   *
+   * @param checkIfValid A function pointer to check if the found device has been paired, and to
+   * load the settings
+   * @param setLastConnection setLastConnection()
+   *
+   * @return #RC_INFO_HANDSHAKE_PENDING if connecting has started
+   * @return #RC_ERROR_ALREADY_CONNECTED if the remote is already connected to a device.
+   */
+  int8_t beginConnect(checkIfValid checkIfValid,
+                      setLastConnection setLastConnection);
+
+  /**
+   * Join a device that is already connected to its main remote
+   *
+   * Used by peers, such as a trainer remote, that were paired with one of
+   * the device's peer pipes (see DeviceProtocol::attachPeer()).  There is no
+   * handshake, the settings saved when pairing are used straight away.
+   *
+   * @param id 5 byte id of the device, as given to saveSettings() when pairing
+   * @param checkIfValid A function pointer to load the settings of the device
+   *
+   * @return 0 if successful
+   * @return #RC_ERROR_ALREADY_CONNECTED if the remote is already connected
+   * @return #RC_ERROR_CONNECTION_REFUSED if the device has not been paired
+   * @return #RC_ERROR_TIMEOUT if the device could not be reached
+   */
+  int8_t join(const uint8_t id[], checkIfValid checkIfValid);
+
+  /**
+   * Continue the handshake started by beginPair() or beginConnect()
+   *
+   * Each call only does as much as it can without waiting, so it can be
+   * called from the main loop while other work carries on.
+   *
+   * @return #RC_INFO_HANDSHAKE_PENDING if the handshake is still running
+   * @return 0 if the handshake was successful, or if already connected
+   * @return #RC_ERROR_NOT_CONNECTED if no handshake is running
+   * @return any error returned by pair() or connect()
+   */
+  int8_t pollHandshake();
+
   /**
    * Check if the transmitter is connected with a receiver.
    *
@@ -158,14 +244,51 @@ public:
    */
   bool isConnected();
 
+  /**
+   * Check if it is time to send the next frame
+   *
+   * Frames are sent in slots of 1 / RCSettings.setCommsFrequency() seconds.
+   * If update() is only called when poll() returns true, update() will never
+   * wait, so the time between slots can be used for other work.
+   *
+   * @return true if a slot is due, false if not, or not connected
+   */
+  bool poll();
+
+  /**
+   * Get the time until the next slot is due
+   *
+   * @return microseconds until the next slot, 0 if it is already due
+   */
+  uint32_t getTimeUntilNextSlot();
+  /**
+   * Move the next slot, and every slot after it, later
+   *
+   * Used by RemoteGroup to keep the slots of several remotes apart.
+   *
+   * @param time microseconds to delay by
+   */
+  void delaySlot(uint32_t time);
+
+  /**
+   * Apply the connection's settings to the radio
+   *
+   * This is only needed when the radio is shared with other remotes, see
+   * RemoteGroup.
+   */
+  void activate();
+
   /**
    * Update the communications with the currently connected device
    *
-   * This function holds until a specific amount of time has passed since
-   * it was last called to fulfill RCSettings.setCommsFrequency()
+   * This function holds until the next slot is due (see poll()) to fulfill
+   * RCSettings.setCommsFrequency(), and then sends the channels.
    *
    * If telemetry is received from the receiver, telemetry will be updated, and
-   * returns 1.
+   * returns 1.  See getTelemetrySize() for how much telemetry was received.
+   *
+   * If there are more channels than fit in one packet, the channels are
+   * sent as a frame of several packets within the same tick.
    *
    * @param channels array of size RCSettings.setNumChannels() to send
    * @param telemetry optional array of size RCSettings.setPayloadSize() to receive
@@ -174,11 +297,27 @@ public:
    * @return >= 0 if successful
    * @return 1 if telemetry was received
    * @return #RC_INFO_TICK_TOO_SHORT if RCSettings.setCommsFrequency() is
-   * too high
+   * too high, or update() was called too late to keep up
    * @return #RC_ERROR_NOT_CONNECTED if there is no device connected
    * @return #RC_ERROR_PACKET_NOT_SENT
    */
   int8_t update(uint16_t channels[], uint8_t telemetry[] = NULL);
+  /**
+   * Update the communications with the currently connected device, reading
+   * the channels just before they are sent
+   *
+   * The same as update(), but once the slot is due, sampleChannels() is
+   * called to read the channels.  Channels given to update() are read by
+   * the caller before it waits for the slot, so they can be up to a period
+   * old by the time they are sent.
+   *
+   * @param sampleChannels sampleChannels()
+   * @param telemetry optional array of size RCSettings.setPayloadSize() to
+   * receive data from the Receiver.
+   *
+   * @return see update()
+   */
+  int8_t update(sampleChannels sampleChannels, uint8_t telemetry[] = NULL);
 
   /**
    * Disconnect From the currently conencted device
@@ -192,6 +331,139 @@ public:
    */
   int8_t disconnect(setLastConnection setLastConnection);
 
+  /**
+   * Change the settings of the connected device without reconnecting
+   *
+   * The new settings are sent in the next slot, and both ends switch to them
+   * before the next frame.  The link is then tested, and if the device can't
+   * be reached with the new settings, both ends go back to the old ones.
+   * This takes a few milliseconds, rather than the seconds of a new
+   * handshake.
+   *
+   * The change only lasts for the connection.  Slots start again from when
+   * the change is made.  A device with peers attached won't change, since
+   * the peers can't follow.
+   *
+   * @note Unlike beginPair() and beginConnect(), this blocks until the change
+   * is done.  It waits for the next slot, up to one comms period, then sends
+   * the settings, each packet with its retries.  The test can then take up to
+   * #RC_ADAPT_TIMEOUT / 2 (125ms by default) when the device doesn't answer.
+   * No frames are sent in the meantime.
+   *
+   * @param settings new settings for the link
+   *
+   * @return 0 if the link is using the new settings
+   * @return #RC_ERROR_NOT_CONNECTED if not connected
+   * @return #RC_ERROR_PACKET_NOT_SENT if the device didn't get the settings
+   * @return #RC_ERROR_LOST_CONNECTION if the test failed, and the old
+   * settings are back in use
+   * @return #RC_ERROR_CONNECTION_REFUSED if the device didn't switch, and the
+   * old settings are back in use
+   */
+  int8_t updateSettings(RCSettings* settings);
+
+  /**
+   * Get the size of the telemetry last received by update()
+   *
+   * With dynamic payloads, the receiver can send less telemetry than
+   * RCSettings.setPayloadSize().  Without, this is always the payload size.
+   *
+   * @return size of the telemetry in bytes
+   */
+  uint8_t getTelemetrySize();
+
+  /**
+   * Get the number of bytes of the current telemetry stream message that
+   * can be read
+   *
+   * Stream messages are sent with DeviceProtocol::writeStream(), and are
+   * received by update() along with the telemetry.  Each fragment can be
+   * read as soon as it arrives, so a message doesn't have to fit in
+   * #RC_STREAM_BUFFER.  A message that loses a fragment, or arrives while
+   * the buffer is full, is cut off and counted in RCStats.streamLost.
+   *
+   * Note: the stream needs RCSettings.setEnableStream() and
+   * RCSettings.setEnableAckPayload()
+   *
+   * @return bytes that can be read, or 0 if there are none
+   */
+  uint16_t getStreamAvailable();
+  /**
+   * Read the telemetry stream
+   *
+   * Reads the bytes that have arrived of the current message, and never
+   * past its end.  Call this after every update() while a message is
+   * coming in, so the buffer has room for the next fragment.
+   *
+   * A message that was cut off never sets last, and the next message sets
+   * first, so what was read of it can be thrown away.
+   *
+   * @param data array to copy the bytes to
+   * @param size size of data in bytes
+   * @param first set to true if the bytes read start a message
+   * @param last set to true if the bytes read end a message
+   *
+   * @return number of bytes read, or 0 if there are none
+   */
+  uint16_t readStream(uint8_t data[], uint16_t size, bool* first = NULL,
+                      bool* last = NULL);
+
+  /**
+   * Get the round trip time of the last acknowledged frame
+   *
+   * This is the time from sending the first packet of a frame to the ack of
+   * the last packet.
+   *
+   * Note: needs RCSettings.setEnableTimestamps() and RCSettings.setEnableAck()
+   *
+   * @return round trip time in micros, or 0 if none has been measured
+   */
+  uint32_t getRoundTripTime();
+  /**
+   * Get a percentile of the round trip times, from RCStats.latency
+   *
+   * @param percent 0-100, 50 for the median
+   *
+   * @return upper limit of the histogram bucket the percentile falls in
+   * (micros), or 0 if none have been measured
+   */
+  uint32_t getLatencyPercentile(uint8_t percent);
+  /**
+   * Get the time of the link clock
+   *
+   * The link clock follows the device's micros(), and is synced from the
+   * times in the ack payloads of frames that were sent in one packet without
+   * retransmits.  Use it to
+   * schedule changes on both ends against the same clock, see
+   * DeviceProtocol::getLinkTime().
+   *
+   * Note: needs RCSettings.setEnableTimestamps() and
+   * RCSettings.setEnableAckPayload()
+   *
+   * @return link time in micros, or 0 if the clocks haven't been synced
+   */
+  uint32_t getLinkTime();
+  /**
+   * Get how fast the device's clock runs compared to this one
+   *
+   * @return drift in parts per million, positive if the device is faster
+   */
+  int32_t getClockDrift();
+
+  /**
+   * Get the statistics of the link
+   *
+   * The statistics are updated by update(), so reading them doesn't touch
+   * the radio.
+   *
+   * @return statistics
+   */
+  RCStats* getStats();
+  /**
+   * Clear the statistics of the link
+   */
+  void resetStats();
+
   /**
    * Get pointer for the current settings
    *
@@ -201,13 +473,221 @@ public:
 
 private:
 
+  //States of the pair and connect handshakes
+  enum {
+    _HANDSHAKE_IDLE = 0,
+    _PAIR_SEND_ID,
+    _PAIR_WAIT_ID,
+    _PAIR_WAIT_SETTINGS,
+    _CONNECT_WAIT_ID,
+    _CONNECT_SEND_REPLY,
+    _CONNECT_SEND_TEST,
+    _CONNECT_WAIT_TEST
+  };
+
+  //frames in each adaptive link control window
+  const uint8_t _ADAPT_WINDOW = 32;
+  //clean windows needed before stepping to a faster link level
+  const uint8_t _ADAPT_GOOD_WINDOWS = 4;
+
   const uint8_t* _remoteId;
   uint8_t _deviceId[5];
 
+  //handshake variables
+  saveSettings* _saveSettings;
+  checkIfValid* _checkIfValid;
+  setLastConnection* _setLastConnection;
+  bool _connectValid;
+
   //update variables
   bool _isConnected;
-  uint32_t _timer;
-  uint16_t _timerDelay;
+  uint32_t _nextSlot;
+  uint32_t _period;
+  uint16_t _periodRemainder;
+  uint16_t _remainder;
+  uint8_t _frameToggle;
+  uint8_t _frameNumber;
+  uint8_t _telemetrySize;
+
+  //adaptive link control variables
+  uint8_t _adaptLevel;
+  uint8_t _adaptBase;
+  uint8_t _adaptGood;
+  uint8_t _adaptFrames;
+  uint32_t _adaptLost;
+  uint32_t _adaptRetransmits;
+  uint32_t _lastAck;
+
+  //delta frame variables
+  uint16_t _sentChannels[RC_MAX_CHANNELS];
+  uint8_t _sinceKeyframe;
+  //frames sent with only the primary channels since the aux channels were
+  //last sent
+  uint16_t _sinceAux;
+  //bitmask of the channels sent in a delta since the last keyframe, kept
+  //with error correction so every delta holds them
+  uint8_t _deltaMask[(RC_MAX_CHANNELS + 7) / 8];
+
+  //States of a stream message being received
+  enum {
+    _STREAM_IDLE = 0,
+    _STREAM_ASSEMBLING,
+    _STREAM_SKIPPING
+  };
+
+  //telemetry stream variables.  Fragments that haven't been read take the
+  //first _streamUsed bytes, and _streamRead bytes of the first one are read.
+  uint8_t _streamBuffer[RC_STREAM_BUFFER];
+  uint16_t _streamUsed;
+  uint8_t _streamRead;
+  uint8_t _streamState;
+  uint8_t _streamSequence;
+
+  //frames kept for matching the timing in ack payloads
+  static const uint8_t _TIMING_FRAMES = 4;
+  //offset error (micros) that is taken as a new clock rather than drift
+  const uint16_t _CLOCK_RESYNC = 5000;
+  //time (micros) to measure the clock drift over
+  const uint32_t _DRIFT_PERIOD = 1000000;
+
+  //When each frame was sent, and when it was acknowledged
+  struct FrameTiming {
+    uint8_t frame;
+    bool acked;
+    //frame was sent in one packet, without retransmits
+    bool clean;
+    uint32_t sent;
+    uint32_t received;
+  };
+
+  //timestamp variables.  The offset is the link clock minus micros(), as of
+  //_clockTime.
+  FrameTiming _timing[_TIMING_FRAMES];
+  uint32_t _roundTrip;
+  bool _clockSynced;
+  uint32_t _clockOffset;
+  uint32_t _clockTime;
+  int32_t _clockDrift;
+  bool _driftMeasured;
+  uint32_t _driftOffset;
+  uint32_t _driftTime;
+
+  /**
+   * Connect to a device that should already be listening, without a
+   * handshake
+   *
+   * @param id 5 byte id of the device
+   * @param settings 32 byte settings of the device
+   *
+   * @return 1 if connected
+   * @return -1 if the device did not reply
+   */
+  int8_t reconnect(const uint8_t id[], const uint8_t settings[]);
+  /**
+   * Resume the connection with a device that may also have been reset
+   *
+   * A challenge with a digest of the settings is sent on the connection's
+   * channel and data rate, until the device answers with its own digest.
+   *
+   * @param id 5 byte id of the device
+   * @param settings 32 byte settings of the device
+   *
+   * @return 1 if connected
+   * @return -1 if the device did not reply, or has different settings
+   */
+  int8_t resume(const uint8_t id[], const uint8_t settings[]);
+  /**
+   * Set up the radio for a connection, without contacting the device
+   *
+   * @param id 5 byte id of the device
+   * @param settings 32 byte settings of the device
+   */
+  void link_start(const uint8_t id[], const uint8_t settings[]);
+
+  /**
+   * Run one step of the pair handshake
+   *
+   * @return see pollHandshake()
+   */
+  int8_t poll_pair();
+  /**
+   * Run one step of the connect handshake
+   *
+   * @return see pollHandshake()
+   */
+  int8_t poll_connect();
+  /**
+   * Finish a successful connect handshake
+   *
+   * @return 0
+   */
+  int8_t connect_finish();
+  /**
+   * Stop the running handshake
+   *
+   * @param status status to return
+   *
+   * @return status
+   */
+  int8_t handshake_end(int8_t status);
+
+  /**
+   * Start adaptive link control at the connection's data rate
+   */
+  void adapt_reset();
+  /**
+   * Start a new adaptive link control window
+   */
+  void adapt_window();
+  /**
+   * Apply a link level to the radio
+   *
+   * @param level index of the link level, 0 being the fastest
+   */
+  void set_link_level(uint8_t level);
+  /**
+   * Set the retry delay, with as many retries as fit in half of a tick
+   *
+   * @param retryDelay see RCSettings.setRetryDelay()
+   */
+  void set_retries(uint8_t retryDelay);
+  /**
+   * Run adaptive link control after a frame has been sent
+   *
+   * Once every window, the loss and retransmits decide whether to step the
+   * link level up or down.  The device is told of the new level with
+   * _PACKET_UPDATE_TRANS_SETTINGS before the remote changes.
+   *
+   * @param status status of the frame
+   */
+  void adapt(int8_t status);
+
+  /**
+   * Use new settings for the link, starting the next frame from scratch
+   *
+   * @param settings 32 byte settings
+   */
+  void switch_settings(const uint8_t* settings);
+  /**
+   * Check that the device can be reached after switching settings, and
+   * that it is using them
+   *
+   * @return 0 if the device replied with the new settings
+   * @return #RC_ERROR_CONNECTION_REFUSED if the device is using other
+   * settings
+   * @return #RC_ERROR_LOST_CONNECTION if the device didn't reply
+   */
+  int8_t test_settings();
+
+  /**
+   * Start scheduling slots from now at RCSettings.setCommsFrequency()
+   */
+  void start_timer();
+  /**
+   * Start the hop sequence from the first frame, which is where the device
+   * waits when it doesn't know where the remote is.
+   */
+  void hop_reset();
 
   /**
    * Send a packet to the receiver
@@ -227,6 +707,111 @@ private:
   int8_t send_packet(void* data, uint8_t dataSize, void* telemetry = NULL,
                      uint8_t telemetrySize = 0);
 
+  /**
+   * Build a delta packet of the channels that changed since the last
+   * acknowledged frame
+   *
+   * @param packet RCSettings.setPayloadSize() size packet to fill
+   * @param channels channels to send
+   *
+   * @return number of bytes used in the packet
+   * @return 0 if the changed channels don't fit in one packet
+   */
+  uint8_t build_delta(uint8_t* packet, uint16_t channels[]);
+  /**
+   * Build a primary packet of the channels set by
+   * RCSettings.setPrimaryChannels()
+   *
+   * @param packet RCSettings.setPayloadSize() size packet to fill
+   * @param channels channels to send
+   *
+   * @return number of bytes used in the packet
+   */
+  uint8_t build_primary(uint8_t* packet, uint16_t channels[]);
+  /**
+   * Check if the aux channels should be sent with this frame
+   *
+   * @return true if every channel is due, or there are no primary channels
+   */
+  bool aux_due();
+
+  /**
+   * Send a channel frame to the receiver
+   *
+   * If the channels don't fit in one packet, the frame is split into
+   * several packets which are all queued in the TX FIFO at once.
+   *
+   * When RCSettings.setKeyframeInterval() is set, a delta frame is sent
+   * instead whenever a keyframe is not due.  When
+   * RCSettings.setPrimaryChannels() is set, only the primary channels are
+   * sent until the aux channels are due.
+   *
+   * @param channels channels to send
+   * @param telemetry data to be set if telemetry is received.
+   *
+   * @return >= 0 if successfull
+   * @return 1 if telemetry was updated
+   * @return #RC_ERROR_PACKET_NOT_SENT
+   */
+  int8_t send_frame(uint16_t channels[], uint8_t telemetry[]);
+  /**
+   * Read every ack payload waiting in the radio
+   *
+   * @param telemetry data to be set if telemetry is received, or NULL
+   *
+   * @return 1 if telemetry was updated
+   * @return 0 if not
+   */
+  int8_t read_acks(uint8_t telemetry[]);
+  /**
+   * Read an ack payload
+   *
+   * @param ack ack payload
+   * @param size size of the ack payload in bytes
+   * @param telemetry data to be set if the payload is telemetry, or NULL
+   *
+   * @return true if telemetry was updated
+   */
+  bool read_ack(uint8_t* ack, uint8_t size, uint8_t telemetry[]);
+  /**
+   * Write the time the frame is sent after the frame number of a channel
+   * packet, if timestamps are enabled
+   *
+   * @param packet channel or delta packet
+   */
+  void write_timestamp(uint8_t* packet);
+  /**
+   * Read the frame timing at the start of a telemetry ack payload, and sync
+   * the link clock from it
+   *
+   * @param ack timing part of the ack payload
+   */
+  void read_timing(uint8_t* ack);
+  /**
+   * Add a measurement of the link clock offset
+   *
+   * @param offset device time minus this time (micros)
+   * @param time when the offset was measured, in micros()
+   * @param bound most the offset can be off by, half the round trip (micros)
+   */
+  void sync_clock(uint32_t offset, uint32_t time, uint32_t bound);
+  /**
+   * Get the link clock offset at a given time, accounting for drift
+   *
+   * @param time in micros()
+   *
+   * @return device time minus this time (micros)
+   */
+  uint32_t clock_offset(uint32_t time);
+  /**
+   * Add a fragment of a stream message to the stream buffer, or drop the
+   * message if it doesn't follow on or there isn't room
+   *
+   * @param ack ack payload holding the fragment
+   * @param size size of the ack payload in bytes
+   */
+  void read_fragment(uint8_t* ack, uint8_t size);
+
 };
 
 #endif
@@ -1,17 +1,31 @@
 #include <RF24.h>
 
 #include "rcSettings.h"
+#include "rcGlobal.h"
 
 RCSettings::RCSettings() {
+  for(int i = 0; i < 32; i++) {
+    _settings[i] = 0;
+  }
+
   setEnableDynamicPayload(false);
   setEnableAck(true);
   setEnableAckPayload(true);
   setStartChannel(0);
   setDataRate(RF24_1MBPS);
+  setEnableAdaptive(false);
+  setEnableStream(false);
+  setEnableTimestamps(false);
+  setEnableErrorCorrection(false);
   setPayloadSize(32);
   setCommsFrequency(60);
   setRetryDelay(15);
   setNumChannels(6);
+  setChannelResolution(16);
+  setKeyframeInterval(0);
+  setHopInterval(0);
+  setPrimaryChannels(0);
+  setAuxFrequency(10);
 }
 
 void RCSettings::setSettings(const uint8_t* settings) {
@@ -73,6 +87,45 @@ rf24_datarate_e RCSettings::getDataRate() {
   }
 }
 
+void RCSettings::setEnableAdaptive(bool enable) {
+  //Put Enable Adaptive in bit 5 of byte 0
+  //0b00100000: 32
+  _settings[0] = (enable ? (_settings[0] | 32) : (_settings[0] & (~32)));
+}
+
+bool RCSettings::getEnableAdaptive() {
+  return (_settings[0] >> 5) & 1;
+}
+
+void RCSettings::setEnableStream(bool enable) {
+  //Put Enable Stream in bit 6 of byte 0
+  //0b01000000: 64
+  _settings[0] = (enable ? (_settings[0] | 64) : (_settings[0] & (~64)));
+}
+
+bool RCSettings::getEnableStream() {
+  return (_settings[0] >> 6) & 1;
+}
+
+void RCSettings::setEnableTimestamps(bool enable) {
+  //Put Enable Timestamps in bit 7 of byte 0
+  //0b10000000: 128
+  _settings[0] = (enable ? (_settings[0] | 128) : (_settings[0] & (~128)));
+}
+
+bool RCSettings::getEnableTimestamps() {
+  return (_settings[0] >> 7) & 1;
+}
+
+void RCSettings::setEnableErrorCorrection(bool enable) {
+  //Put Enable Error Correction in bit 0 of byte 10
+  _settings[10] = (enable ? (_settings[10] | 1) : (_settings[10] & (~1)));
+}
+
+bool RCSettings::getEnableErrorCorrection() {
+  return _settings[10] & 1;
+}
+
 void RCSettings::setStartChannel(uint8_t channel) {
   _settings[1] = channel;
 }
@@ -86,15 +139,22 @@ void RCSettings::setPayloadSize(uint8_t payload)  {
 }
 
 uint8_t RCSettings::getPayloadSize() {
-  return _settings[2];
+  //Every channel packet needs room for its header (the type, frame number
+  //and timestamp) and at least one channel.
+  uint8_t header = getEnableTimestamps() ? 6 : 2;
+  uint8_t least = header + (getChannelResolution() + 7) / 8;
+  return constrain(_settings[2], least, 32);
 }
 
-void RCSettings::setCommsFrequency(uint8_t frequency) {
-  _settings[3] = frequency;
+void RCSettings::setCommsFrequency(uint16_t frequency) {
+  //A frequency of 0 would never send anything
+  frequency = max(frequency, 1);
+  _settings[3] = frequency & 0xFF;
+  _settings[8] = frequency >> 8;
 }
 
-uint8_t RCSettings::getCommsFrequency() {
-  return _settings[3];
+uint16_t RCSettings::getCommsFrequency() {
+  return max((_settings[8] << 8) | _settings[3], 1);
 }
 
 void RCSettings::setRetryDelay(uint8_t time) {
@@ -108,11 +168,57 @@ uint8_t RCSettings::getRetryDelay() {
 }
 
 void RCSettings::setNumChannels(uint8_t numChannels) {
-  _settings[5] = numChannels;
+  _settings[5] = min(numChannels, RC_MAX_CHANNELS);
 }
 
 uint8_t RCSettings::getNumChannels() {
-  return _settings[5];
+  //Settings saved or sent with more channels than this build holds are cut
+  //down to fit
+  return min(_settings[5], RC_MAX_CHANNELS);
+}
+
+void RCSettings::setChannelResolution(uint8_t bits) {
+  _settings[6] = constrain(bits, 1, 16);
+}
+
+uint8_t RCSettings::getChannelResolution() {
+  //Settings saved before the resolution existed will have a 0 here.
+  if(_settings[6] == 0 || _settings[6] > 16) {
+    return 16;
+  }
+  return _settings[6];
+}
+
+void RCSettings::setKeyframeInterval(uint8_t frames) {
+  _settings[7] = frames;
+}
+
+uint8_t RCSettings::getKeyframeInterval() {
+  return _settings[7];
+}
+
+void RCSettings::setHopInterval(uint8_t frames) {
+  _settings[9] = min(frames, 15);
+}
+
+uint8_t RCSettings::getHopInterval() {
+  return min(_settings[9], 15);
+}
+
+void RCSettings::setPrimaryChannels(uint8_t channels) {
+  _settings[11] = channels;
+}
+
+uint8_t RCSettings::getPrimaryChannels() {
+  return _settings[11];
+}
+
+void RCSettings::setAuxFrequency(uint8_t frequency) {
+  _settings[12] = max(frequency, 1);
+}
+
+uint8_t RCSettings::getAuxFrequency() {
+  return max(_settings[12], 1);
 }
 
 void RCSettings::printSettings() {
@@ -129,6 +235,18 @@ void RCSettings::printSettings() {
   Serial.println(getDataRate() == RF24_1MBPS ? "1MBPS" :
                  (getDataRate() == RF24_250KBPS ? "250MBPS" : "2MBPS"));
 
+  Serial.print("Adaptive: ");
+  Serial.println(getEnableAdaptive() ? "True" : "False");
+
+  Serial.print("Stream: ");
+  Serial.println(getEnableStream() ? "True" : "False");
+
+  Serial.print("Timestamps: ");
+  Serial.println(getEnableTimestamps() ? "True" : "False");
+
+  Serial.print("Error Correction: ");
+  Serial.println(getEnableErrorCorrection() ? "True" : "False");
+
   Serial.print("Channel: ");
   Serial.println(getStartChannel());
 
@@ -144,8 +262,23 @@ void RCSettings::printSettings() {
   Serial.print("Num Channels: ");
   Serial.println(getNumChannels());
 
+  Serial.print("Resolution: ");
+  Serial.println(getChannelResolution());
+
+  Serial.print("Keyframe Interval: ");
+  Serial.println(getKeyframeInterval());
+
+  Serial.print("Hop Interval: ");
+  Serial.println(getHopInterval());
+
+  Serial.print("Primary Channels: ");
+  Serial.println(getPrimaryChannels());
+
+  Serial.print("Aux Frequency: ");
+  Serial.println(getAuxFrequency());
+
   Serial.println("Array:");
-  for(int i = 0; i < 5; i++) {
+  for(int i = 0; i < 13; i++) {
     Serial.print("  ");
     Serial.print(i);
     Serial.print(": ");
@@ -33,11 +33,13 @@ public:
    * Enable/Disable Dynamic payloads
    *
    * Dynamic payloads don't have a specific payload size, and will
-   * vary from transaction to transaction.
+   * vary from transaction to transaction.  Only the bytes that are used are
+   * sent, so a frame of 6 channels at 16 bits is 14 bytes instead of 32 (2
+   * bytes of header and 12 of channels), and telemetry can be shorter than
+   * the payload size.  setEnableTimestamps() adds 4 bytes to the header.
    *
-   * @warning DynamicPayloads are not currently implemented
-   *
-   * If you disable dynamic payloads, see setPayloadSize()
+   * With dynamic payloads, setPayloadSize() is the largest packet that will
+   * be sent.  If you disable dynamic payloads, see setPayloadSize()
    *
    * Uses `0b00000001` of byte 0
    *
@@ -128,12 +130,124 @@ public:
    */
   rf24_datarate_e getDataRate();
 
+  /**
+   * Enable/Disable Adaptive link control
+   *
+   * When enabled, the remote watches the loss and retransmits of the link,
+   * and steps the data rate and PA level of both devices up or down to suit
+   * the range.  The retry delay and count of the remote are matched to the
+   * data rate and comms frequency.
+   *
+   * If either device stops hearing the other after a change, both fall back
+   * to setDataRate().  setEnableAck() needs to be enabled for this to work.
+   *
+   * Uses `0b00100000` of byte 0
+   *
+   * Default: false
+   *
+   * @param enable
+   */
+  void setEnableAdaptive(bool enable);
+  /**
+   * Get the currently set value from setEnableAdaptive()
+   *
+   * @return enable adaptive link control
+   */
+  bool getEnableAdaptive();
+
+  /**
+   * Enable/Disable the Telemetry Stream
+   *
+   * When enabled, the device can send messages of any length to the remote
+   * with DeviceProtocol::writeStream().  Messages are split over the ack
+   * payloads of several frames, taking turns with the normal telemetry, and
+   * are put back together by the remote, see RemoteProtocol::readStream().
+   *
+   * Every ack payload starts with a header byte, so the normal telemetry
+   * can be one byte less than setPayloadSize().  setEnableAckPayload()
+   * needs to be enabled for this to work.
+   *
+   * Uses `0b01000000` of byte 0
+   *
+   * Default: false
+   *
+   * @param enable
+   */
+  void setEnableStream(bool enable);
+  /**
+   * Get the currently set value from setEnableStream()
+   *
+   * @return enable the telemetry stream
+   */
+  bool getEnableStream();
+
+  /**
+   * Enable/Disable Timestamps
+   *
+   * When enabled, every channel frame carries the time it was sent, and
+   * every telemetry ack payload carries the time the device received the
+   * last frame.  The remote uses them to measure the round trip time of
+   * each frame, and to keep a link clock that follows the device's clock,
+   * see RemoteProtocol::getLinkTime().  The device measures how long each
+   * frame took to reach it, see DeviceProtocol::getFrameLatency().
+   *
+   * Channel packets are 4 bytes larger and the telemetry is 5 bytes smaller.
+   * setEnableAckPayload() needs to be enabled for the clocks to be synced.
+   *
+   * Uses `0b10000000` of byte 0
+   *
+   * Default: false
+   *
+   * @param enable
+   */
+  void setEnableTimestamps(bool enable);
+  /**
+   * Get the currently set value from setEnableTimestamps()
+   *
+   * @return enable timestamps
+   */
+  bool getEnableTimestamps();
+
+  /**
+   * Enable/Disable Forward Error Correction
+   *
+   * Without acks, a lost packet is never sent again.  When enabled with
+   * setEnableAck() off, frames are sent so the device can recover the latest
+   * channels from the frames after a loss:
+   *
+   * - Keyframes are followed by a parity packet, so any one packet of the
+   *   frame can be lost.  A keyframe of one packet is sent twice.
+   * - Delta frames hold every channel changed since the last keyframe, so a
+   *   lost delta is made up by the next one, see setKeyframeInterval().
+   *   Deltas based on a keyframe the device didn't get are dropped.
+   *
+   * Without delta frames, a frame of one packet already holds every channel,
+   * so it is sent as it is.  Has no effect with acks, since lost packets are
+   * retried.
+   *
+   * Uses `0b00000001` of byte 10
+   *
+   * Default: false
+   *
+   * @param enable
+   */
+  void setEnableErrorCorrection(bool enable);
+  /**
+   * Get the currently set value from setEnableErrorCorrection()
+   *
+   * @return enable forward error correction
+   */
+  bool getEnableErrorCorrection();
+
   /**
    * Starting radio Channel.
    *
    * There are 128 channels (0-127) to choose from.  Selecting an
    * arbitrary number can help lower the chances of interference.
    *
+   * When setHopInterval() is set, this is only used to make the hop
+   * sequence.
+   *
    * Uses byte 1
    *
    * Default: 0
@@ -153,7 +267,10 @@ public:
    *
    * Set the size of the payload in bytes
    *
-   * @note This can't be set higher than 32
+   * @note This can't be set higher than 32, or lower than the header of a
+   * channel packet plus one channel.  Smaller sizes are read back as the
+   * smallest that fits, which is 3 to 8 bytes depending on
+   * setChannelResolution() and setEnableTimestamps().
    *
    * @warning Values other than 32 are not fully implemented, use at your own risk!
    *
@@ -175,23 +292,24 @@ public:
    * Communication Frequency
    *
    * Set the number of transactions the transmitter will send per second.
-   * The max frequency is 255hz.
+   * The max frequency is around 1000hz, though the link must be able to send
+   * a whole frame (including retries) within each period.
    *
-   * Uses byte 3
+   * Uses byte 3, and byte 8 for the high byte
    *
    * Default: 60
    *
-   * @note the actual frequency will become more innacurate as the set
-   * frequency is increased.
+   * @note The transmitter schedules frames with micros(), so the average
+   * frequency is exact, even when 1000000 / frequency is not a whole number.
    *
    */
-  void setCommsFrequency(uint8_t frequency);
+  void setCommsFrequency(uint16_t frequency);
   /**
    * Get the currently set value from setCommsFrequency()
    *
    * @return frequency
    */
-  uint8_t getCommsFrequency();
+  uint16_t getCommsFrequency();
 
   /**
    * Retry Delay
@@ -227,17 +345,21 @@ public:
   /**
    * Number of channels in a packet
    *
-   * Set the number of channels in a packet, each channel uses 2 bytes
-   * default, so a 32 byte packet can hold up to 15 channels.
+   * Set the number of channels in a packet.  The channels are packed
+   * together at getChannelResolution() bits each, after a 2 byte header (6
+   * bytes with setEnableTimestamps()).  A 32 byte packet can hold up to 15
+   * channels at 16 bits, 20 channels at 12 bits, or 24 channels at 10 bits,
+   * and 13, 17 or 20 channels with timestamps.
    *
-   * @note In the future, I may support multi-packet transmissions to allow more
-   * channels.
+   * If there are more channels than fit in one packet, each frame is split
+   * into as many as 8 packets.  This can't be set higher than
+   * #RC_MAX_CHANNELS.
    *
    * Uses byte 5
    *
    * Default: 6
    *
-   * @param numChannels number of channels to send (1 to 15)
+   * @param numChannels number of channels to send
    */
   void setNumChannels(uint8_t numChannels);
   /**
@@ -247,6 +369,143 @@ public:
    */
   uint8_t getNumChannels();
 
+  /**
+   * Channel Resolution
+   *
+   * Set the number of bits each channel uses in a packet.  Channels are
+   * packed together with no padding, so a lower resolution fits more channels
+   * in a packet, or the same channels in a smaller payload.
+   *
+   * Channel values sent with a lower resolution must be between 0 and
+   * 2^resolution - 1, larger values are clamped to the maximum.
+   *
+   * Uses byte 6
+   *
+   * Default: 16
+   *
+   * @param bits number of bits per channel (1 to 16)
+   */
+  void setChannelResolution(uint8_t bits);
+  /**
+   * Get the currently set value from setChannelResolution()
+   *
+   * @return bits per channel
+   */
+  uint8_t getChannelResolution();
+
+  /**
+   * Keyframe Interval
+   *
+   * When set, the remote only sends the channels that have changed since the
+   * last acknowledged frame (a delta frame), and sends every channel (a
+   * keyframe) once every interval frames.  Delta frames are only used when
+   * the changed channels fit in one packet.
+   *
+   * This works best with setEnableDynamicPayload(), since delta frames are
+   * smaller than a full frame.
+   *
+   * @note Without acknowledgements, a lost delta frame is only corrected by
+   * the next keyframe, so keep the interval short.
+   *
+   * Uses byte 7
+   *
+   * Default: 0
+   *
+   * @param frames number of frames between keyframes, 0 to always send
+   * every channel
+   */
+  void setKeyframeInterval(uint8_t frames);
+  /**
+   * Get the currently set value from setKeyframeInterval()
+   *
+   * @return frames between keyframes
+   */
+  uint8_t getKeyframeInterval();
+
+  /**
+   * Hop Interval
+   *
+   * When set, the remote and device hop between #RC_HOP_CHANNELS channels
+   * every interval frames.  The hop sequence is made from the start channel
+   * and the ids of the remote and device, so paired links nearby will hop
+   * differently.  A device that misses frames keeps hopping on time, and if
+   * it loses the remote for long enough it waits on the first channel of the
+   * sequence until the remote comes back around.
+   *
+   * Every channel frame has a frame number, which is used by the device to
+   * find its place in the sequence.
+   *
+   * @note update() on the device should be called several times per comms
+   * period, since the device hops half way between frames.
+   *
+   * Uses byte 9
+   *
+   * Default: 0
+   *
+   * @param frames number of frames on each channel (1 to 15), 0 to stay on
+   * the start channel
+   */
+  void setHopInterval(uint8_t frames);
+  /**
+   * Get the currently set value from setHopInterval()
+   *
+   * @return frames per channel
+   */
+  uint8_t getHopInterval();
+
+  /**
+   * Primary Channels
+   *
+   * When set, only the first channels are sent every frame, and the rest of
+   * the channels (the aux channels) are sent at setAuxFrequency().  Frames
+   * that only carry the primary channels fit in one small packet, so fast
+   * channels such as throttle and sticks can be sent at a high comms
+   * frequency while switches are sent far less often.  The device keeps the
+   * last aux channels it was sent between their updates.
+   *
+   * The primary channels must fit in one packet, and any more are sent with
+   * the aux channels.
+   *
+   * This works best with setEnableDynamicPayload(), since frames with only
+   * the primary channels are smaller than a full frame.
+   *
+   * Uses byte 11
+   *
+   * Default: 0
+   *
+   * @param channels number of channels sent every frame, 0 to send every
+   * channel every frame
+   */
+  void setPrimaryChannels(uint8_t channels);
+  /**
+   * Get the currently set value from setPrimaryChannels()
+   *
+   * @return number of primary channels
+   */
+  uint8_t getPrimaryChannels();
+
+  /**
+   * Aux Frequency
+   *
+   * How often the aux channels are sent when setPrimaryChannels() is set.
+   * The aux channels are sent with the primary channels on the first frame
+   * after they are due, so the frequency is rounded to a whole number of
+   * frames.
+   *
+   * Uses byte 12
+   *
+   * Default: 10
+   *
+   * @param frequency frequency in Hz to send the aux channels (1 to 255)
+   */
+  void setAuxFrequency(uint8_t frequency);
+  /**
+   * Get the currently set value from setAuxFrequency()
+   *
+   * @return frequency of the aux channels in Hz
+   */
+  uint8_t getAuxFrequency();
+
   /**
    * Print the settings to Serial.
    */